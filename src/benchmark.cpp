@@ -0,0 +1,66 @@
+#include "benchmark.hpp"
+
+#include <algorithm>
+
+// nearest rank on sorted samples
+static double percentile(const std::vector<double>& sorted, double p) {
+  if (sorted.empty()) return 0.0;
+  const size_t rank { static_cast<size_t>(ceil(p / 100.0 * sorted.size())) };
+  return sorted[glm::clamp<size_t>(rank, 1, sorted.size()) - 1];
+}
+
+// device strings come from the driver, keep the output valid json whatever they contain
+static void print_json_string(FILE* f, const std::string& s) {
+  fputc('"', f);
+  for (char c : s) {
+    if (c == '"' || c == '\\') fprintf(f, "\\%c", c);
+    else if (static_cast<unsigned char>(c) < 0x20) fprintf(f, "\\u%04x", c);
+    else fputc(c, f);
+  }
+  fputc('"', f);
+}
+
+static void print_json_times(FILE* f, const char* name, const std::vector<double>& ms, bool last) {
+  std::vector<double> sorted { ms };
+  std::sort(sorted.begin(), sorted.end());
+
+  double total { 0.0 };
+  for (double t : ms) total += t;
+
+  fprintf(f, "  \"%s\": {\n", name);
+  fprintf(f, "    \"mean\": %.4f,\n", sorted.empty() ? 0.0 : total / sorted.size());
+  fprintf(f, "    \"min\": %.4f,\n", sorted.empty() ? 0.0 : sorted.front());
+  fprintf(f, "    \"max\": %.4f,\n", sorted.empty() ? 0.0 : sorted.back());
+  fprintf(f, "    \"p50\": %.4f,\n", percentile(sorted, 50.0));
+  fprintf(f, "    \"p95\": %.4f,\n", percentile(sorted, 95.0));
+  fprintf(f, "    \"p99\": %.4f\n",  percentile(sorted, 99.0));
+  fprintf(f, "  }%s\n", last ? "" : ",");
+}
+
+void benchmark_t::print_json(FILE* f) const {
+  double total_ms { 0.0 };
+  for (double ms : frame_ms) total_ms += ms;
+
+  const double frames { static_cast<double>(frame_ms.size()) };
+  const double pixels { static_cast<double>(width) * height * frames };
+
+  fprintf(f, "{\n");
+  fprintf(f, "  \"backend\": ");  print_json_string(f, backend); fprintf(f, ",\n");
+  fprintf(f, "  \"device\": ");   print_json_string(f, device);  fprintf(f, ",\n");
+  fprintf(f, "  \"width\": %d,\n", width);
+  fprintf(f, "  \"height\": %d,\n", height);
+  fprintf(f, "  \"warmup_frames\": %d,\n", warmup);
+  fprintf(f, "  \"frames\": %d,\n", static_cast<int>(frame_ms.size()));
+  fprintf(f, "  \"dt\": %g,\n", dt);
+  fprintf(f, "  \"relaxation\": %g,\n", relaxation);
+  fprintf(f, "  \"prepass\": %s,\n", prepass ? "true" : "false");
+  fprintf(f, "  \"footprint\": %g,\n", footprint);
+  print_json_times(f, "frame_ms", frame_ms, false);
+  if (!gpu_ms.empty())
+    print_json_times(f, "gpu_ray_march_ms", gpu_ms, false);
+  fprintf(f, "  \"mrays_per_s\": %.4f,\n", total_ms > 0.0 ? pixels / (total_ms * 1000.0) : 0.0);
+  fprintf(f, "  \"steps_per_pixel\": %.4f,\n", pixels > 0.0 ? march_steps / pixels : 0.0);
+  fprintf(f, "  \"shadow_steps_per_pixel\": %.4f,\n", pixels > 0.0 ? shadow_steps / pixels : 0.0);
+  fprintf(f, "  \"sdf_calls_per_pixel\": %.4f\n", pixels > 0.0 ? sdf_calls / pixels : 0.0);
+  fprintf(f, "}\n");
+}
@@ -0,0 +1,30 @@
+#ifndef _BENCHMARK_H_
+#define _BENCHMARK_H_
+
+#include "main.hpp"
+
+#include <string>
+#include <vector>
+
+// results of a --benchmark run, frames follow the camera path with a fixed dt
+struct benchmark_t {
+  std::string         backend;           // "gl" or "cpu"
+  std::string         device;            // GL_RENDERER or the SIMD path and thread count
+  int                 width       { 0 };
+  int                 height      { 0 };
+  int                 warmup      { 0 };
+  float               dt          { 0.0f };
+  float               relaxation  { 1.0f }; // ray_march_params_t::relaxation
+  bool                prepass     { false }; // ray_march_params_t::prepass
+  float               footprint   { 0.0f }; // ray_march_params_t::footprint
+  std::vector<double> frame_ms;          // measured frames only
+  std::vector<double> gpu_ms;            // GPU time of the ray march pass, GL only
+  // per pixel counters summed over the measured frames, see frag_stats
+  uint64_t            march_steps  { 0 };
+  uint64_t            shadow_steps { 0 };
+  uint64_t            sdf_calls    { 0 };
+
+  void print_json (FILE*) const;
+};
+
+#endif // _BENCHMARK_H_
@@ -0,0 +1,118 @@
+#include "brick_map.hpp"
+
+#include <chrono>
+
+#define BRICK_SAMPLES (BRICK_SIZE + 1)
+
+bool brick_map_t::bake(const scene_bvh_t& bvh, scheduler_t& scheduler) {
+  const auto start { std::chrono::steady_clock::now() };
+  coarse.clear();
+  index.clear();
+  atlas.clear();
+  bricks = 0;
+
+  // the box holds the bounded objects with a quarter of its size around them
+  vec3 box_lo, box_hi;
+  if (!bvh.box(box_lo, box_hi)) return false;
+  const vec3 pad { 0.25f * (box_hi - box_lo) + 1e-3f };
+  box_lo -= pad;
+  box_hi += pad;
+
+  const vec3 extent { box_hi - box_lo };
+  cell  = glm::max(extent.x, glm::max(extent.y, extent.z)) / BRICK_MAX_CELLS;
+  cells = glm::max(ivec3(1), ivec3(glm::ceil(extent / cell)));
+  lo    = box_lo;
+  near  = cell / BRICK_SIZE;
+
+  // the coarse samples a slice of z at a time
+  const ivec3 corners { cells + 1 };
+  coarse.resize(static_cast<size_t>(corners.x) * corners.y * corners.z);
+  scheduler.run(corners.z, [&] (int z) {
+    for (int y = 0; y < corners.y; ++y)
+      for (int x = 0; x < corners.x; ++x)
+        coarse[(static_cast<size_t>(z) * corners.y + y) * corners.x + x] = bvh.eval(lo + vec3(x, y, z) * cell);
+  });
+
+  // cells the surface can pass within a cell diagonal of get a brick, while the atlas has room
+  const int  max_slots { BRICK_MAX_ATLAS / BRICK_SAMPLES };
+  const float diag     { 1.7320508f * cell };
+  std::vector<ivec3> brick_cells;
+  index.assign(static_cast<size_t>(cells.x) * cells.y * cells.z, BRICK_FAR);
+  for (int z = 0; z < cells.z; ++z)
+    for (int y = 0; y < cells.y; ++y)
+      for (int x = 0; x < cells.x; ++x) {
+        float d_min { INFINITY }, d_max { -INFINITY };
+        for (int c = 0; c < 8; ++c) {
+          const float d { coarse[(static_cast<size_t>(z + (c >> 2)) * corners.y + y + ((c >> 1) & 1)) * corners.x + x + (c & 1)] };
+          d_min = glm::min(d_min, d);
+          d_max = glm::max(d_max, d);
+        }
+        if (d_min >= diag || d_max <= -diag) continue;
+        int& entry { index[(static_cast<size_t>(z) * cells.y + y) * cells.x + x] };
+        if (static_cast<int>(brick_cells.size()) >= max_slots * max_slots * max_slots) {
+          entry = BRICK_FULL;
+          continue;
+        }
+        entry = static_cast<int>(brick_cells.size());
+        brick_cells.push_back(ivec3(x, y, z));
+      }
+  bricks = static_cast<int>(brick_cells.size());
+
+  // slots fill x first, the atlas is as small as the bricks allow
+  slots.x = glm::max(1, glm::min(max_slots, bricks));
+  slots.y = glm::max(1, glm::min(max_slots, (bricks + slots.x - 1) / slots.x));
+  slots.z = glm::max(1, (bricks + slots.x * slots.y - 1) / (slots.x * slots.y));
+  const ivec3 size { slots * BRICK_SAMPLES };
+  atlas.assign(static_cast<size_t>(size.x) * size.y * size.z, 0.0f);
+
+  const float voxel { cell / BRICK_SIZE };
+  scheduler.run(bricks, [&] (int b) {
+    const ivec3 slot { b % slots.x, (b / slots.x) % slots.y, b / (slots.x * slots.y) };
+    const ivec3 base { slot * BRICK_SAMPLES };
+    const vec3  origin { lo + vec3(brick_cells[b]) * cell };
+    for (int z = 0; z < BRICK_SAMPLES; ++z)
+      for (int y = 0; y < BRICK_SAMPLES; ++y)
+        for (int x = 0; x < BRICK_SAMPLES; ++x)
+          atlas[(static_cast<size_t>(base.z + z) * size.y + base.y + y) * size.x + base.x + x] =
+            bvh.eval(origin + vec3(x, y, z) * voxel);
+  });
+
+  bake_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+  return true;
+}
+
+// trilinear interpolation of the 8 samples around g in a grid of the given size, x fastest
+static float trilinear(const float* samples, ivec3 size, ivec3 base, vec3 f) {
+  auto at = [&] (int x, int y, int z) {
+    return samples[(static_cast<size_t>(base.z + z) * size.y + base.y + y) * size.x + base.x + x];
+  };
+  const float x00 { mix(at(0, 0, 0), at(1, 0, 0), f.x) };
+  const float x10 { mix(at(0, 1, 0), at(1, 1, 0), f.x) };
+  const float x01 { mix(at(0, 0, 1), at(1, 0, 1), f.x) };
+  const float x11 { mix(at(0, 1, 1), at(1, 1, 1), f.x) };
+  return mix(mix(x00, x10, f.y), mix(x01, x11, f.y), f.z);
+}
+
+float brick_map_t::bound(vec3 p) const {
+  if (index.empty()) return -INFINITY;
+  const vec3 g { (p - lo) / cell };
+  if (g.x < 0.0f || g.y < 0.0f || g.z < 0.0f || g.x >= cells.x || g.y >= cells.y || g.z >= cells.z) return -INFINITY;
+
+  const ivec3 c    { glm::min(ivec3(g), cells - 1) };
+  const int   slot { index[(static_cast<size_t>(c.z) * cells.y + c.y) * cells.x + c.x] };
+  if (slot == BRICK_FAR) return trilinear(coarse.data(), cells + 1, c, g - vec3(c)) - BRICK_MARGIN * cell;
+  if (slot < 0) return -INFINITY;
+
+  // the voxel of the brick p is in, the brick's first sample is at the cell's corner
+  const vec3  local { (g - vec3(c)) * static_cast<float>(BRICK_SIZE) };
+  const ivec3 v     { glm::min(ivec3(local), ivec3(BRICK_SIZE - 1)) };
+  const ivec3 base  { ivec3(slot % slots.x, (slot / slots.x) % slots.y, slot / (slots.x * slots.y)) * BRICK_SAMPLES + v };
+  return trilinear(atlas.data(), slots * BRICK_SAMPLES, base, local - vec3(v)) - BRICK_MARGIN * cell / BRICK_SIZE;
+}
+
+std::string brick_map_t::glsl() const {
+  char defines[128];
+  snprintf(defines, sizeof(defines), "#define SDF_BRICKS\n#define BRICK_SIZE %d\n#define BRICK_MARGIN %.3f\n",
+           BRICK_SIZE, static_cast<double>(BRICK_MARGIN));
+  return defines;
+}
@@ -0,0 +1,51 @@
+#ifndef _BRICK_MAP_H_
+#define _BRICK_MAP_H_
+
+#include "main.hpp"
+#include "bvh.hpp"
+#include "scheduler.hpp"
+
+#include <string>
+#include <vector>
+
+// voxels along a brick's edge, it holds BRICK_SIZE + 1 samples along each so bricks filter
+// on their own
+#define BRICK_SIZE      8
+// coarse cells along the longest side of the baked box
+#define BRICK_MAX_CELLS 48
+// atlas texels along each side, what GL 3.3 guarantees for 3D textures
+#define BRICK_MAX_ATLAS 256
+// trilinear filtering of the samples of a 1-Lipschitz field overshoots by at most sqrt(3)/2
+// of a voxel, the rest is slack for the filtering precision of the GPU
+#define BRICK_MARGIN    0.9f
+// index entries of cells without a brick
+#define BRICK_FAR       -1 // far from the surface, the coarse samples are enough
+#define BRICK_FULL      -2 // near it, but the atlas had no room, evaluate the scene
+
+// sdf_scene sampled over a box around the scene's bounded objects: a coarse grid everywhere
+// and a brick of finer samples in each cell close to the surface. the marchers step on the
+// trilinear samples less BRICK_MARGIN voxels, a lower bound of the distance, until that drops
+// below near and evaluate the scene from there. baked for one set of slider values
+struct brick_map_t {
+  vec3               lo      { 0.0f };
+  float              cell    { 0.0f }; // coarse cell size, brick voxels are BRICK_SIZE times smaller
+  ivec3              cells   { 0 };
+  // bounds below a voxel are steps much shorter than the scene's, rays grazing a surface would
+  // crawl along it, the marchers evaluate the scene instead
+  float              near    { 0.0f };
+  std::vector<float> coarse;           // (cells + 1)^3 samples at the cell corners, x fastest
+  std::vector<int>   index;            // per cell its atlas slot, BRICK_FAR or BRICK_FULL
+  ivec3              slots   { 0 };    // atlas slots along each axis
+  std::vector<float> atlas;            // slots * (BRICK_SIZE + 1) samples along each axis
+  int                bricks  { 0 };
+  double             bake_ms { 0.0 };
+
+  // false when the scene has nothing bounded to bake around, the map is empty then
+  bool        bake  (const scene_bvh_t&, scheduler_t&); // the bvh built on the bound scene
+  bool        empty (void) const { return index.empty(); }
+  // lower bound of the distance at p, -INFINITY where the scene has to be evaluated
+  float       bound (vec3) const;
+  std::string glsl  (void) const; // defines for fragment.glsl, the samples go through shader_t::set_bricks
+};
+
+#endif // _BRICK_MAP_H_
@@ -0,0 +1,186 @@
+#include "bvh.hpp"
+
+#include <algorithm>
+
+void scene_bvh_t::init(const scene_t& scene) {
+  scene_objects(scene, objects);
+}
+
+// lower bound of the distance of everything under the node
+static float bvh_lower(const cull_bounds_t& b, vec3 p) {
+  return (length(p - b.centre) - b.alpha) / b.beta;
+}
+
+static vfloat bvh_lower(const cull_bounds_t& b, const vvec3& p) {
+  return (vlength(p - vvec3(b.centre)) - b.alpha) / vfloat(b.beta);
+}
+
+// fills node with the objects order[first, last), unbounded ones come first in order
+static void build_node(scene_bvh_t& bvh, const std::vector<cull_bounds_t>& bounds, std::vector<int>& order,
+                       int node, int first, int last, int unbounded) {
+  if (last - first == 1) {
+    bvh.nodes[node].bounds = bounds[order[first]];
+    bvh.nodes[node].object = order[first];
+    return;
+  }
+
+  int mid { (first + last) / 2 };
+  if (first < unbounded && unbounded < last) {
+    mid = unbounded; // the bounded ones in a subtree of their own
+  } else if (first >= unbounded) {
+    // split at the median along the axis the centres spread the most
+    vec3 lo { INFINITY }, hi { -INFINITY };
+    for (int i = first; i < last; ++i) {
+      lo = glm::min(lo, bounds[order[i]].centre);
+      hi = glm::max(hi, bounds[order[i]].centre);
+    }
+    const vec3 extent { hi - lo };
+    const int  axis   { extent.x >= extent.y && extent.x >= extent.z ? 0 : extent.y >= extent.z ? 1 : 2 };
+    std::nth_element(order.begin() + first, order.begin() + mid, order.begin() + last, [&] (int a, int b) {
+      return bounds[a].centre[axis] < bounds[b].centre[axis];
+    });
+  }
+
+  const int child { static_cast<int>(bvh.nodes.size()) };
+  bvh.nodes.resize(bvh.nodes.size() + 2);
+  bvh.nodes[node].child = child;
+  build_node(bvh, bounds, order, child,     first, mid,  unbounded);
+  build_node(bvh, bounds, order, child + 1, mid,   last, unbounded);
+  bvh.nodes[node].bounds = merge_bounds(bvh.nodes[child].bounds, bvh.nodes[child + 1].bounds);
+}
+
+void scene_bvh_t::build(const scene_t& scene) {
+  std::vector<cull_bounds_t> bounds(objects.size());
+  tapes.resize(objects.size());
+  for (size_t i = 0; i < objects.size(); ++i) {
+    bounds[i]         = cull_bounds(scene, objects[i].node);
+    objects[i].centre = bounds[i].centre;
+    objects[i].radius = bounds[i].alpha;
+    scene.prune(objects[i].node, tapes[i]);
+  }
+
+  std::vector<int> order(objects.size());
+  for (size_t i = 0; i < order.size(); ++i) order[i] = static_cast<int>(i);
+  const int unbounded { static_cast<int>(std::stable_partition(order.begin(), order.end(), [&] (int i) {
+    return std::isinf(bounds[i].alpha);
+  }) - order.begin()) };
+
+  // an empty scene is one leaf, sdf_object() of no objects is 1e10 too
+  nodes.assign(1, bvh_node_t {});
+  if (!objects.empty()) build_node(*this, bounds, order, 0, 0, static_cast<int>(objects.size()), unbounded);
+
+  texels.resize(nodes.size() * 8);
+  for (size_t i = 0; i < nodes.size(); ++i) {
+    const bvh_node_t& n { nodes[i] };
+    float*            t { &texels[i * 8] };
+    t[0] = n.bounds.centre.x;
+    t[1] = n.bounds.centre.y;
+    t[2] = n.bounds.centre.z;
+    t[3] = n.bounds.alpha;
+    t[4] = n.bounds.beta;
+    t[5] = static_cast<float>(n.child);
+    t[6] = static_cast<float>(n.object);
+    t[7] = 0.0f;
+  }
+}
+
+// pending nodes carry the lower bound they were pushed with, they're skipped once the best
+// distance drops to it. the nearer child goes on top so the best distance drops early
+float scene_bvh_t::eval(vec3 p, uint64_t* instructions, int* nearest) const {
+  int   stack[BVH_STACK];
+  float lower[BVH_STACK];
+  int   top { 1 };
+  float d   { 1e10f };
+  stack[0] = 0;
+  lower[0] = bvh_lower(nodes[0].bounds, p);
+
+  while (top > 0) {
+    --top;
+    if (lower[top] >= d) continue;
+    const bvh_node_t& n { nodes[stack[top]] };
+    if (n.child < 0) {
+      if (n.object >= static_cast<int>(tapes.size())) continue;
+      const float o { eval_tape(tapes[n.object], p) };
+      if (nearest && o < d) *nearest = n.object;
+      d = glm::min(d, o);
+      if (instructions) *instructions += tapes[n.object].size();
+      continue;
+    }
+    const float a { bvh_lower(nodes[n.child].bounds, p) };
+    const float b { bvh_lower(nodes[n.child + 1].bounds, p) };
+    const bool  a_near { a <= b };
+    stack[top] = a_near ? n.child + 1 : n.child;
+    lower[top] = a_near ? b : a;
+    ++top;
+    stack[top] = a_near ? n.child : n.child + 1;
+    lower[top] = a_near ? a : b;
+    ++top;
+  }
+  return d;
+}
+
+// the scene is the min over the objects, so its gradient is the nearest one's
+vec4 scene_bvh_t::eval_dual(vec3 p) const {
+  int nearest { -1 };
+  const float d { eval(p, nullptr, &nearest) };
+  return eval_dual(p, nearest, d);
+}
+
+vec4 scene_bvh_t::eval_dual(vec3 p, int nearest, float d) const {
+  return nearest < 0 ? vec4(d, 0.0f, 0.0f, 0.0f) : eval_tape_dual(tapes[nearest], p);
+}
+
+// a node is visited when any lane could still find something closer in it
+vfloat scene_bvh_t::eval(const vvec3& p, uint64_t* instructions, int* nearest) const {
+  int    stack[BVH_STACK];
+  vfloat lower[BVH_STACK];
+  int    top { 1 };
+  vfloat d   { 1e10f };
+  stack[0] = 0;
+  lower[0] = bvh_lower(nodes[0].bounds, p);
+  if (nearest)
+    for (int i = 0; i < SIMD_WIDTH; ++i) nearest[i] = -1;
+
+  while (top > 0) {
+    --top;
+    if (!any(lower[top] < d)) continue;
+    const bvh_node_t& n { nodes[stack[top]] };
+    if (n.child < 0) {
+      if (n.object >= static_cast<int>(tapes.size())) continue;
+      const vfloat o { eval_tape(tapes[n.object], p) };
+      if (nearest) {
+        const int closer { (o < d).bits() };
+        for (int i = 0; i < SIMD_WIDTH; ++i)
+          if (closer & (1 << i)) nearest[i] = n.object;
+      }
+      d = vmin(d, o);
+      if (instructions) *instructions += tapes[n.object].size();
+      continue;
+    }
+    const vfloat a { bvh_lower(nodes[n.child].bounds, p) };
+    const vfloat b { bvh_lower(nodes[n.child + 1].bounds, p) };
+    const bool   a_near { !any(b < a) };
+    stack[top] = a_near ? n.child + 1 : n.child;
+    lower[top] = a_near ? b : a;
+    ++top;
+    stack[top] = a_near ? n.child : n.child + 1;
+    lower[top] = a_near ? a : b;
+    ++top;
+  }
+  return d;
+}
+
+bool scene_bvh_t::box(vec3& lo, vec3& hi) const {
+  lo = vec3(INFINITY);
+  hi = vec3(-INFINITY);
+  for (const cull_object_t& o : objects) {
+    if (std::isinf(o.radius)) continue;
+    lo = glm::min(lo, o.centre - o.radius);
+    hi = glm::max(hi, o.centre + o.radius);
+  }
+  return lo.x <= hi.x;
+}
+
+std::string scene_bvh_t::glsl() const {
+  return "#define SDF_BVH\n#define BVH_STACK " + std::to_string(BVH_STACK) + "\n";
+}
@@ -0,0 +1,46 @@
+#ifndef _BVH_H_
+#define _BVH_H_
+
+#include "main.hpp"
+#include "scene.hpp"
+#include "simd.hpp"
+#include "tile_cull.hpp"
+
+#include <string>
+#include <vector>
+
+// nodes a query keeps pending, a median split tree this deep holds millions of objects
+#define BVH_STACK 24
+
+// a node bounds everything below it like cull_bounds_t does, so (|p - centre| - alpha) / beta
+// is at most the distance of any object under it. leaves hold one object
+struct bvh_node_t {
+  cull_bounds_t bounds;
+  int           child  { -1 }; // the first of two adjacent children, -1 for leaves
+  int           object { 0  };
+};
+
+// a tree over the scene's objects (tile_cull.hpp) for queries of the whole scene: the min over
+// the objects only descends into the nodes whose bound is below the best distance so far.
+// objects with unbounded distance (planes) sit in their own subtree, which is always visited
+struct scene_bvh_t {
+  std::vector<cull_object_t>              objects;
+  std::vector<std::vector<scene_instr_t>> tapes; // per object, for the cpu
+  std::vector<bvh_node_t>                 nodes; // root first
+  std::vector<float>                      texels; // two vec4s per node for fragment.glsl's u_bvh
+
+  void        init  (const scene_t&); // finds the objects, again whenever the scene changes
+  void        build (const scene_t&); // bound scene, rebuilt every frame as the sliders move
+  // the scene's distance, counting the tape instructions it ran when given a counter and
+  // telling which object was nearest when asked, -1 for none (one per lane for packets)
+  float       eval  (vec3, uint64_t* = nullptr, int* = nullptr) const;
+  vfloat      eval  (const vvec3&, uint64_t* = nullptr, int* = nullptr) const;
+  // distance and gradient, the nearest object's dual. given the nearest object and the
+  // scene's distance eval() found, it only differentiates that object's tape
+  vec4        eval_dual (vec3) const;
+  vec4        eval_dual (vec3, int, float) const;
+  std::string glsl  (void) const; // defines for fragment.glsl, after objects_glsl
+  bool        box   (vec3&, vec3&) const; // around the bounded objects after build, false if there are none
+};
+
+#endif // _BVH_H_
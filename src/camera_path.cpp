@@ -0,0 +1,67 @@
+#include "camera_path.hpp"
+
+bool camera_path_t::load(const char* path) {
+  FILE* f { fopen(path, "r") };
+  if (f == NULL) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Could not open camera path `%s`", path);
+    return false;
+  }
+
+  keys.clear();
+  char line[512];
+  int  line_no { 0 };
+  while (fgets(line, sizeof(line), f)) {
+    ++line_no;
+    if (char* comment = strchr(line, '#')) *comment = '\0';
+
+    camera_key_t k {};
+    const int n { sscanf(line, "%f %f %f %f %f %f %f %f %f %f",
+                         &k.time, &k.position.x, &k.position.y, &k.position.z, &k.yaw, &k.pitch,
+                         &k.slider.x, &k.slider.y, &k.slider.z, &k.slider.w) };
+    if (n <= 0) continue; // blank line
+
+    if (n != 6 && n != 10) {
+      SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "%s:%d: expected 6 or 10 values, got %d", path, line_no, n);
+      fclose(f);
+      return false;
+    }
+    if (!keys.empty() && k.time < keys.back().time) {
+      SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "%s:%d: keys must be sorted by time", path, line_no);
+      fclose(f);
+      return false;
+    }
+    keys.push_back(k);
+  }
+  fclose(f);
+
+  if (keys.empty()) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Camera path `%s` has no keys", path);
+    return false;
+  }
+  return true;
+}
+
+float camera_path_t::duration() const {
+  return keys.empty() ? 0.0f : keys.back().time - keys.front().time;
+}
+
+// leaves camera and sliders alone when there are no keys
+void camera_path_t::sample(float t, camera_t& camera, float slider_values[4]) const {
+  if (keys.empty()) return;
+
+  size_t i { 0 };
+  while (i + 1 < keys.size() && keys[i + 1].time <= t) ++i;
+
+  const camera_key_t& a { keys[i] };
+  const camera_key_t& b { keys[glm::min(i + 1, keys.size() - 1)] };
+  const float span { b.time - a.time };
+  const float s    { span > 0.0f ? glm::clamp((t - a.time) / span, 0.0f, 1.0f) : 0.0f };
+
+  camera.position = vec4(mix(a.position, b.position, s), 1.0f);
+  camera.velocity = vec4(0.0f, 0.0f, 0.0f, 1.0f);
+  camera.yaw      = mix(a.yaw,   b.yaw,   s);
+  camera.pitch    = mix(a.pitch, b.pitch, s);
+
+  const vec4 slider { mix(a.slider, b.slider, s) };
+  for (int j = 0; j < 4; ++j) slider_values[j] = slider[j];
+}
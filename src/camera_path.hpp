@@ -0,0 +1,27 @@
+#ifndef _CAMERA_PATH_H_
+#define _CAMERA_PATH_H_
+
+#include "main.hpp"
+
+#include <vector>
+
+// one line per key in a camera path file, '#' starts a comment:
+//   time  x y z  yaw pitch  [slider0 slider1 slider2 slider3]
+// keys must be sorted by time, values in between are linearly interpolated
+struct camera_key_t {
+  float time     { 0.0f };
+  vec3  position { 0.0f, 1.0f, 0.0f };
+  float yaw      { 0.0f };
+  float pitch    { 0.0f };
+  vec4  slider   { 0.5f, 0.5f, 0.5f, 0.5f };
+};
+
+struct camera_path_t {
+  std::vector<camera_key_t> keys;
+
+  bool  load     (const char*);
+  float duration (void) const;
+  void  sample   (float, camera_t&, float [4]) const;
+};
+
+#endif // _CAMERA_PATH_H_
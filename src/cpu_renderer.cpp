@@ -0,0 +1,688 @@
+#include "cpu_renderer.hpp"
+
+#include <algorithm>
+
+// the functions below follow fragment.glsl line for line
+
+static const vec3 light_pos { 0.0f, 15.0f, 0.0f };
+
+static float sdf_scene(const cpu_frame_t& f, vec3 p) {
+  if (f.bvh) return f.bvh->eval(p);
+  return f.lod ? eval_tape(f.lod->at(p), p) : f.scene->eval(p);
+}
+
+static vfloat sdf_scene(const cpu_frame_t& f, const vvec3& p) {
+  if (f.bvh) return f.bvh->eval(p);
+  return f.lod ? eval_tape(f.lod->at(p), p) : f.scene->eval(p);
+}
+
+static vec4 sdf_scene_dual(const cpu_frame_t& f, vec3 p) {
+  if (f.bvh) return f.bvh->eval_dual(p);
+  return f.lod ? eval_tape_dual(f.lod->at(p), p) : f.scene->eval_dual(p);
+}
+
+// blue - green - red, same ramp as heat() in fragment.glsl
+static vec3 heat(float t) {
+  t = clamp(t, 0.0f, 1.0f);
+  return clamp(vec3(4.0f * t - 2.0f, 2.0f - abs(4.0f * t - 2.0f), 2.0f - 4.0f * t), 0.0f, 1.0f);
+}
+
+// the brick map's bound is worth a step above this, the scene takes over below
+static float brick_near(const cpu_frame_t& f) {
+  return glm::max(f.bricks->near, f.rmp.surf_dist);
+}
+
+// the distance at p, d along the ray. primary rays pass their tile's tapes, shadow rays leave
+// the tile and use the whole scene
+static float sdf_march(const cpu_frame_t& f, vec3 p, float d, tile_tapes_t* tiles) {
+  if (!tiles) return sdf_scene(f, p);
+  const std::vector<scene_instr_t>& tape { tiles->at(d) };
+  if (f.bvh && &tape == &f.scene->tape) return f.bvh->eval(p, &tiles->instructions);
+  tiles->instructions += tape.size();
+  return eval_tape(tape, p);
+}
+
+static float segment_march(const cpu_frame_t& f, vec3 ro, vec3 rd, float start, int& steps, tile_tapes_t* tiles) {
+  float d = start;
+  float pixel = f.rmp.footprint / f.resolution.y;
+
+  for (int i = 0; i < f.rmp.max_steps; ++i) {
+    ++steps;
+    vec3 p = ro + rd * d;
+    float ds = sdf_march(f, p, d, tiles);
+    if (ds < glm::max(f.rmp.surf_dist, d * pixel)) {
+      d += ds;
+      break;
+    }
+    float s = ds * SCENE_SEGMENT_GROWTH;
+    float l = f.scene->eval_bound(p + rd * (s * 0.5f), s * 0.5f).z;
+    d += glm::min(ds / l, s);
+    if (d > f.rmp.max_dist) break;
+  }
+
+  return d;
+}
+
+// over-relaxed like fragment.glsl's, going back to the plain step once the balls stop overlapping
+// and relaxing again once the distance grows
+static float ray_march(const cpu_frame_t& f, vec3 ro, vec3 rd, float start, int& steps, int& brick_steps,
+                       tile_tapes_t* tiles) {
+  if (f.segment) return segment_march(f, ro, rd, start, steps, tiles);
+  float d = start;
+  float w = f.rmp.relaxation;
+  float step = 0.0f;
+  float prev = 0.0f;
+  float pixel = f.rmp.footprint / f.resolution.y;
+
+  for (int i = 0; i < f.rmp.max_steps; ++i) {
+    ++steps;
+    vec3 p = ro + rd * d;
+    if (f.bricks) {
+      const float b { f.bricks->bound(p) };
+      if (b > brick_near(f)) {
+        ++brick_steps;
+        if (w > 1.0f && b + prev < step) {
+          d += prev - step;
+          w = 1.0f;
+          continue;
+        }
+        d += b;
+        step = prev = b;
+        if (d > f.rmp.max_dist) break;
+        continue;
+      }
+    }
+    float ds = sdf_march(f, p, d, tiles);
+    bool missed = w > 1.0f && abs(ds) + prev < step;
+    if (missed) {
+      d += prev - step;
+      w = 1.0f;
+      continue;
+    }
+    if (ds < glm::max(f.rmp.surf_dist, d * pixel)) {
+      d += ds;
+      break;
+    }
+    if (ds > prev) w = f.rmp.relaxation; // moving away from what it backed off from
+    step = ds * w;
+    prev = abs(ds);
+    d += step;
+    if (d > f.rmp.max_dist) break;
+  }
+
+  return d;
+}
+
+static float cone_march(const cpu_frame_t& f, vec3 ro, vec3 rd, float start, float k, int& steps) {
+  float d = start;
+
+  for (int i = 0; i < f.rmp.max_steps; ++i) {
+    ++steps;
+    vec3 p = ro + rd * d;
+    float ds = sdf_scene(f, p);
+    if (f.segment) ds /= glm::max(f.scene->eval_bound(p, ds).z, 1.0f);
+    float r = d * k;
+    if (ds < r + f.rmp.surf_dist) break;
+    d += (ds - r) / (1.0f + k);
+    if (d > f.rmp.max_dist) break;
+  }
+
+  return glm::min(d, f.rmp.max_dist);
+}
+
+static vec3 normal(const cpu_frame_t& f, vec3 p) {
+  const vec4 d = sdf_scene_dual(f, p);
+  return normalize(vec3(d.y, d.z, d.w));
+}
+
+// the brick map is left out, its bounds fall short of the distance by up to most of a cell
+// and the penumbra comes out too dark
+static float shadow_march(const cpu_frame_t& f, vec3 ro, vec3 rd, float max_t, int& steps) {
+  float res = 1.0f;
+  float t = 0.0f;
+
+  for (int i = 0; i < f.rmp.shadow_steps && t < max_t; ++i) {
+    ++steps;
+    vec3 p = ro + rd * t;
+    float h = sdf_scene(f, p);
+    if (h < f.rmp.surf_dist) return 0.0f;
+    if (f.segment) {
+      float s = h * SCENE_SEGMENT_GROWTH;
+      h = glm::min(h / f.scene->eval_bound(p + rd * (s * 0.5f), s * 0.5f).z, s);
+    }
+    res = glm::min(res, f.rmp.penumbra * h / glm::max(t, f.rmp.surf_dist));
+    t += h;
+  }
+
+  return res;
+}
+
+static float get_light(const cpu_frame_t& f, vec3 p, vec3 n, int& shadow_steps) {
+  vec3 l = normalize(light_pos - p);
+
+  float dif = clamp(dot(n, l), 0.0f, 1.0f);
+  float lit = shadow_march(f, p + n * f.rmp.surf_dist * 2.0f, l, length(light_pos - p), shadow_steps);
+  return dif * mix(0.1f, 1.0f, lit);
+}
+
+static vec4 shade_pixel(const cpu_frame_t& f, vec2 frag_coord, float start, vec4& stats, tile_tapes_t* tiles) {
+  vec2 uv = (frag_coord-0.5f*f.resolution)/f.resolution.y;
+
+  vec3 col = vec3(0);
+
+  vec3  ro   = f.camera_pos;
+  float zoom = 1.0f;
+
+  vec3 look_at = vec3(cos(f.mouse.y) * sin(f.mouse.x),
+                      sin(f.mouse.y),
+                      cos(f.mouse.y) * cos(f.mouse.x));
+
+  vec3 fw = normalize(look_at);
+  vec3 r  = cross(vec3(0., 1., 0.), fw);
+  vec3 u  = cross(fw, r);
+  vec3 c  = ro + fw * zoom;
+  vec3 i  = c + uv.x*r + uv.y*u;
+  vec3 rd = normalize(i-ro);
+
+  int   steps = 0, brick_steps = 0;
+  float d = ray_march(f, ro, rd, start, steps, brick_steps, tiles);
+  vec3  p = ro + rd * d;
+
+  // one normal for the lighting and the colour
+  vec3  n = normal(f, p);
+  int   shadow_steps = 0;
+  float dif = get_light(f, p, n, shadow_steps);
+  col = vec3(dif);
+  col += n * -0.5f;
+
+  // one sdf_scene call per march step not taken on the brick map plus the normal's
+  stats = vec4(steps, shadow_steps, steps + shadow_steps - brick_steps + 1, brick_steps);
+  return vec4(col, 1.0f);
+}
+
+// packet versions of the above, every lane runs the scalar code path
+// but lanes that already hit or escaped stop accumulating distance
+
+// the brick map's bounds of the active lanes when all of them are worth a step, the scene's
+// distance is evaluated for the whole packet otherwise so the first lane that isn't ends it
+static bool brick_bound(const cpu_frame_t& f, const vvec3& p, vmask active, vfloat& bound) {
+  float x[SIMD_WIDTH], y[SIMD_WIDTH], z[SIMD_WIDTH], b[SIMD_WIDTH];
+  p.x.store(x);
+  p.y.store(y);
+  p.z.store(z);
+  const int lanes { active.bits() };
+  for (int i = 0; i < SIMD_WIDTH; ++i) {
+    b[i] = 0.0f;
+    if (!(lanes & (1 << i))) continue;
+    b[i] = f.bricks->bound(vec3(x[i], y[i], z[i]));
+    if (!(b[i] > brick_near(f))) return false;
+  }
+  bound = vfloat::load(b);
+  return true;
+}
+
+// segment tracing looks at each ray's own segment ahead, the lanes march one at a time
+static vfloat segment_march(const cpu_frame_t& f, const vvec3& ro, const vvec3& rd, vfloat start, vfloat& steps,
+                            tile_tapes_t* tiles) {
+  float ox[SIMD_WIDTH], oy[SIMD_WIDTH], oz[SIMD_WIDTH], dx[SIMD_WIDTH], dy[SIMD_WIDTH], dz[SIMD_WIDTH];
+  float d[SIMD_WIDTH], n[SIMD_WIDTH];
+  ro.x.store(ox);
+  ro.y.store(oy);
+  ro.z.store(oz);
+  rd.x.store(dx);
+  rd.y.store(dy);
+  rd.z.store(dz);
+  start.store(d);
+  steps.store(n);
+  for (int i = 0; i < SIMD_WIDTH; ++i) {
+    int lane_steps { 0 };
+    d[i] = segment_march(f, vec3(ox[i], oy[i], oz[i]), vec3(dx[i], dy[i], dz[i]), d[i], lane_steps, tiles);
+    n[i] += static_cast<float>(lane_steps);
+  }
+  steps = vfloat::load(n);
+  return vfloat::load(d);
+}
+
+static vfloat ray_march(const cpu_frame_t& f, const vvec3& ro, const vvec3& rd, vfloat start, vfloat& steps,
+                        vfloat& brick_steps, tile_tapes_t* tiles) {
+  if (f.segment) return segment_march(f, ro, rd, start, steps, tiles);
+  vfloat d      = start;
+  vfloat w      = f.rmp.relaxation;
+  vfloat step   = 0.0f;
+  vfloat prev   = 0.0f;
+  vfloat pixel  = f.rmp.footprint / f.resolution.y;
+  vmask  active { true };
+
+  for (int i = 0; i < f.rmp.max_steps && any(active); ++i) {
+    steps += select(active, 1.0f, 0.0f);
+    vvec3  p  = ro + rd * d;
+    vfloat b;
+    if (f.bricks && brick_bound(f, p, active, b)) {
+      brick_steps += select(active, 1.0f, 0.0f);
+      const vmask missed = active & (w > vfloat(1.0f)) & (b + prev < step);
+      const vmask moved  = andnot(active, missed);
+      d      = select(missed, d + prev - step, select(moved, d + b, d));
+      w      = select(missed, 1.0f, w);
+      step   = select(moved, b, step);
+      prev   = select(moved, b, prev);
+      active = andnot(active, moved & (d > f.rmp.max_dist));
+      continue;
+    }
+    vfloat ds;
+    if (tiles) {
+      const std::vector<scene_instr_t>& tape { tiles->at(d, active) };
+      uint64_t instructions { tape.size() };
+      if (f.bvh && &tape == &f.scene->tape) {
+        instructions = 0;
+        ds = f.bvh->eval(p, &instructions);
+      } else {
+        ds = eval_tape(tape, p);
+      }
+      tiles->instructions += instructions * static_cast<uint64_t>(count(active));
+    } else {
+      ds = sdf_scene(f, p);
+    }
+    // lanes that missed go back to their plain step, the ones that hit take the distance unrelaxed
+    const vmask missed = active & (w > vfloat(1.0f)) & (vabs(ds) + prev < step);
+    const vmask hit    = andnot(active, missed) & (ds < vmax(f.rmp.surf_dist, d * pixel));
+    const vmask moved  = andnot(andnot(active, missed), hit);
+    d      = select(missed, d + prev - step, select(hit, d + ds, select(moved, d + ds * w, d)));
+    w      = select(missed, 1.0f, select(moved & (ds > prev), f.rmp.relaxation, w));
+    step   = select(moved, ds * w, step);
+    prev   = select(moved, vabs(ds), prev);
+    active = andnot(active, hit | (moved & (d > f.rmp.max_dist)));
+  }
+
+  return d;
+}
+
+// the lanes one at a time, each hit's gradient is a single pass over its tape. the bvh finds
+// every lane's nearest object in one packet traversal, then only their tapes are differentiated
+static vvec3 normal(const cpu_frame_t& f, const vvec3& p) {
+  float x[SIMD_WIDTH], y[SIMD_WIDTH], z[SIMD_WIDTH], d[SIMD_WIDTH];
+  int   nearest[SIMD_WIDTH];
+  p.x.store(x);
+  p.y.store(y);
+  p.z.store(z);
+  if (f.bvh) f.bvh->eval(p, nullptr, nearest).store(d);
+  for (int i = 0; i < SIMD_WIDTH; ++i) {
+    const vec3 q { x[i], y[i], z[i] };
+    const vec4 g { f.bvh ? f.bvh->eval_dual(q, nearest[i], d[i]) : sdf_scene_dual(f, q) };
+    const vec3 n { normalize(vec3(g.y, g.z, g.w)) };
+    x[i] = n.x;
+    y[i] = n.y;
+    z[i] = n.z;
+  }
+  return vvec3(vfloat::load(x), vfloat::load(y), vfloat::load(z));
+}
+
+// lanes leave at a surface or the light. segment tracing bounds each lane's own segment, the
+// lanes march one at a time like segment_march
+static vfloat shadow_march(const cpu_frame_t& f, const vvec3& ro, const vvec3& rd, vfloat max_t, vfloat& steps) {
+  if (f.segment) {
+    float ox[SIMD_WIDTH], oy[SIMD_WIDTH], oz[SIMD_WIDTH], dx[SIMD_WIDTH], dy[SIMD_WIDTH], dz[SIMD_WIDTH];
+    float t[SIMD_WIDTH], res[SIMD_WIDTH], n[SIMD_WIDTH];
+    ro.x.store(ox);
+    ro.y.store(oy);
+    ro.z.store(oz);
+    rd.x.store(dx);
+    rd.y.store(dy);
+    rd.z.store(dz);
+    max_t.store(t);
+    steps.store(n);
+    for (int i = 0; i < SIMD_WIDTH; ++i) {
+      int lane_steps { 0 };
+      res[i] = shadow_march(f, vec3(ox[i], oy[i], oz[i]), vec3(dx[i], dy[i], dz[i]), t[i], lane_steps);
+      n[i] += static_cast<float>(lane_steps);
+    }
+    steps = vfloat::load(n);
+    return vfloat::load(res);
+  }
+  vfloat res    = 1.0f;
+  vfloat t      = 0.0f;
+  vmask  active { true };
+
+  for (int i = 0; i < f.rmp.shadow_steps; ++i) {
+    active = active & (t < max_t);
+    if (!any(active)) break;
+    steps += select(active, 1.0f, 0.0f);
+    vvec3  p   = ro + rd * t;
+    vfloat h   = sdf_scene(f, p);
+    vmask  hit = active & (h < f.rmp.surf_dist);
+    res    = select(hit, 0.0f, select(active, vmin(res, f.rmp.penumbra * h / vmax(t, f.rmp.surf_dist)), res));
+    active = andnot(active, hit);
+    t      = select(active, t + h, t);
+  }
+
+  return res;
+}
+
+static vfloat get_light(const cpu_frame_t& f, const vvec3& p, const vvec3& n, vfloat& shadow_steps) {
+  const vvec3  to_light   = vvec3(light_pos) - p;
+  const vfloat light_dist = vlength(to_light);
+  const vvec3  l          = to_light * (1.0f / light_dist);
+
+  vfloat dif = vclamp(vdot(n, l), 0.0f, 1.0f);
+  vfloat lit = shadow_march(f, p + n * (f.rmp.surf_dist * 2.0f), l, light_dist, shadow_steps);
+  return dif * (0.1f + lit * 0.9f);
+}
+
+static vvec3 shade_packet(const cpu_frame_t& f, vfloat frag_x, vfloat frag_y, vfloat start,
+                          vfloat& steps, vfloat& shadow_steps, vfloat& brick_steps, tile_tapes_t* tiles) {
+  vfloat uv_x = (frag_x - 0.5f*f.resolution.x)/f.resolution.y;
+  vfloat uv_y = (frag_y - 0.5f*f.resolution.y)/f.resolution.y;
+
+  vec3  ro   = f.camera_pos;
+  float zoom = 1.0f;
+
+  vec3 look_at = vec3(cos(f.mouse.y) * sin(f.mouse.x),
+                      sin(f.mouse.y),
+                      cos(f.mouse.y) * cos(f.mouse.x));
+
+  vec3  fw = normalize(look_at);
+  vec3  r  = cross(vec3(0., 1., 0.), fw);
+  vec3  u  = cross(fw, r);
+  vvec3 rd = vnormalize(vvec3(fw * zoom) + vvec3(r) * uv_x + vvec3(u) * uv_y);
+
+  vfloat d = ray_march(f, vvec3(ro), rd, start, steps, brick_steps, tiles);
+  vvec3  p = vvec3(ro) + rd * d;
+
+  vvec3  n   = normal(f, p);
+  vfloat dif = get_light(f, p, n, shadow_steps);
+  return vvec3(dif, dif, dif) + n * -0.5f;
+}
+
+// direction of the primary ray through frag_coord, as shade_pixel computes it
+static vec3 primary_dir(const cpu_frame_t& f, vec2 frag_coord) {
+  vec2 uv = (frag_coord-0.5f*f.resolution)/f.resolution.y;
+
+  vec3 look_at = vec3(cos(f.mouse.y) * sin(f.mouse.x),
+                      sin(f.mouse.y),
+                      cos(f.mouse.y) * cos(f.mouse.x));
+
+  vec3 fw = normalize(look_at);
+  vec3 r  = cross(vec3(0., 1., 0.), fw);
+  vec3 u  = cross(fw, r);
+  return normalize(fw + uv.x*r + uv.y*u);
+}
+
+void tile_tapes_t::init(const scene_t* s, vec3 o, vec3 dir, float sp, float max_dist) {
+  scene        = s;
+  origin       = o;
+  centre_dir   = dir;
+  spread       = sp;
+  instructions = 0;
+  num_slabs    = 0;
+  for (float end = CPU_SLAB_FIRST; end < max_dist && num_slabs < CPU_MAX_SLABS - 1; end *= CPU_SLAB_RATIO)
+    slab_end[num_slabs++] = end;
+  slab_end[num_slabs++] = max_dist;
+  for (int k = 0; k < num_slabs; ++k) built[k] = pair_built[k] = false;
+}
+
+// a point at distance t in [t0, t1] along a ray of the tile is at most t1 * spread from the
+// centre ray's point at t, which is at most (t1 - t0) / 2 from the middle of the range
+void tile_tapes_t::prune(int first, int last, std::vector<scene_instr_t>& tape) const {
+  const float t0     { first ? slab_end[first - 1] : 0.0f };
+  const float t1     { slab_end[last] };
+  const float radius { t1 * spread + 0.5f * (t1 - t0) };
+  scene->prune(origin + centre_dir * (0.5f * (t0 + t1)), radius * 1.001f + 1e-3f, tape);
+}
+
+const std::vector<scene_instr_t>& tile_tapes_t::slab(int k) {
+  if (!built[k]) prune(k, k, tapes[k]);
+  built[k] = true;
+  return tapes[k];
+}
+
+const std::vector<scene_instr_t>& tile_tapes_t::pair(int k) {
+  if (!pair_built[k]) prune(k, k + 1, pair_tapes[k]);
+  pair_built[k] = true;
+  return pair_tapes[k];
+}
+
+const std::vector<scene_instr_t>& tile_tapes_t::at(float t) {
+  if (t < 0.0f) return scene->tape; // marched backwards out of a surface it started in
+  for (int k = 0; k < num_slabs; ++k)
+    if (t < slab_end[k]) return slab(k);
+  return scene->tape;
+}
+
+// the lanes of a packet are neighbours, when they aren't in one slab they're mostly in two
+const std::vector<scene_instr_t>& tile_tapes_t::at(vfloat t, vmask active) {
+  if (any(active & (t < vfloat(0.0f)))) return scene->tape;
+  for (int k = 0; k < num_slabs; ++k) {
+    if (any(andnot(active, t < vfloat(slab_end[k])))) continue; // a lane is further out
+    if (k == 0 || !any(active & (t < vfloat(slab_end[k - 1])))) return slab(k);
+    if (k == 1 || !any(active & (t < vfloat(slab_end[k - 2])))) return pair(k - 1);
+    return scene->tape;
+  }
+  return scene->tape;
+}
+
+bool lod_tapes_t::init(const scene_t* s, vec3 e) {
+  scene = s;
+  eye   = e;
+  ends.clear();
+  for (size_t i = 0; i < s->nodes.size(); ++i)
+    if (s->nodes[i].kind == SCENE_LOD && std::isfinite(s->bound[i * SCENE_MAX_PARAMS]))
+      ends.push_back(s->bound[i * SCENE_MAX_PARAMS]);
+  std::sort(ends.begin(), ends.end());
+  ends.erase(std::unique(ends.begin(), ends.end()), ends.end());
+  if (ends.empty()) return false;
+  tapes.resize(ends.size() + 1);
+  for (size_t k = 0; k < tapes.size(); ++k)
+    s->prune_lod(k ? ends[k - 1] : 0.0f, k < ends.size() ? ends[k] : INFINITY, tapes[k]);
+  return true;
+}
+
+const std::vector<scene_instr_t>& lod_tapes_t::shell(float t) const {
+  return tapes[static_cast<size_t>(std::upper_bound(ends.begin(), ends.end(), t) - ends.begin())];
+}
+
+const std::vector<scene_instr_t>& lod_tapes_t::at(vec3 p) const {
+  return shell(length(p - eye));
+}
+
+const std::vector<scene_instr_t>& lod_tapes_t::at(const vvec3& p) const {
+  float t[SIMD_WIDTH];
+  vlength(p - vvec3(eye)).store(t);
+  const std::vector<scene_instr_t>& first { shell(t[0]) };
+  for (int i = 1; i < SIMD_WIDTH; ++i)
+    if (&shell(t[i]) != &first) return scene->tape;
+  return first;
+}
+
+void cpu_framebuffer_t::resize(int w, int h, cpu_format_t fmt) {
+  if (pixels && w == width && h == height && fmt == format) return;
+  free(pixels);
+  free(stats);
+  width  = w;
+  height = h;
+  format = fmt;
+  checkp(pixels = calloc(static_cast<size_t>(w) * static_cast<size_t>(h), pixel_size()));
+  checkp(stats  = static_cast<float*>(calloc(static_cast<size_t>(w) * static_cast<size_t>(h), 4 * sizeof(float))));
+}
+
+size_t cpu_framebuffer_t::pixel_size() const {
+  return (format == CPU_FORMAT_RGBA8) ? 4 * sizeof(uint8_t) : 4 * sizeof(float);
+}
+
+cpu_framebuffer_t::~cpu_framebuffer_t() {
+  free(pixels);
+  free(stats);
+}
+
+cpu_renderer_t::cpu_renderer_t(int num_threads) : scheduler(num_threads) {}
+
+void cpu_renderer_t::run(cpu_framebuffer_t& fb, const scene_t& scene, ray_march_params_t rmp,
+                         float slider_values[4], const camera_t& camera) {
+  frame.rmp        = rmp;
+  frame.slider     = vec4(slider_values[0], slider_values[1], slider_values[2], slider_values[3]);
+  frame.camera_pos = vec3(camera.position);
+  bound_scene      = scene;
+  frame.scene      = &bound_scene;
+  frame.bvh        = nullptr;
+  frame.lod        = nullptr;
+  frame.bricks     = nullptr;
+  frame.segment    = segment;
+  // baking samples the scene a few hundred thousand times, frames with the same sliders share it.
+  // lod nodes keep their first child for it, the bake doesn't follow the camera
+  if (bricks && (baked_scene != &scene || frame.slider != baked_slider)) {
+    bound_scene.bind(frame.slider);
+    scene_bvh.init(bound_scene);
+    scene_bvh.build(bound_scene);
+    brick_map.bake(scene_bvh, scheduler);
+    baked_scene  = &scene;
+    baked_slider = frame.slider;
+  }
+  if (bricks && !brick_map.empty()) frame.bricks = &brick_map;
+  bound_scene.bind(frame.slider, &frame.camera_pos);
+  if (lod_tapes.init(&bound_scene, frame.camera_pos)) frame.lod = &lod_tapes;
+  if (bvh) {
+    scene_bvh.init(bound_scene);
+    scene_bvh.build(bound_scene);
+    frame.bvh = &scene_bvh;
+  }
+  frame.mouse      = vec2(camera.yaw, camera.pitch);
+  frame.resolution = vec2(static_cast<float>(fb.width), static_cast<float>(fb.height));
+  target           = &fb;
+
+  // tile cost varies a lot between sky and grazing rays, the scheduler balances it by stealing
+  tiles_x = (fb.width + CPU_TILE_SIZE - 1) / CPU_TILE_SIZE;
+  const int num_tiles { tiles_x * ((fb.height + CPU_TILE_SIZE - 1) / CPU_TILE_SIZE) };
+  march_steps.store(0);
+  shadow_steps.store(0);
+  sdf_calls.store(0);
+  brick_steps.store(0);
+  prepass_steps.store(0);
+  march_instructions.store(0);
+  scheduler.run(num_tiles, [this] (int tile) { draw_tile(tile); });
+}
+
+void cpu_renderer_t::draw_tile(int tile) {
+  const int x0 { (tile % tiles_x) * CPU_TILE_SIZE };
+  const int y0 { (tile / tiles_x) * CPU_TILE_SIZE };
+  const int x1 { glm::min(x0 + CPU_TILE_SIZE, target->width)  };
+  const int y1 { glm::min(y0 + CPU_TILE_SIZE, target->height) };
+
+  // reused by the tiles a worker draws, so pruning doesn't allocate once it's warm
+  thread_local tile_tapes_t tiles;
+  {
+    const vec3 centre { primary_dir(frame, vec2(0.5f * (x0 + x1), 0.5f * (y0 + y1))) };
+    float      spread { 0.0f };
+    for (int c = 0; c < 4; ++c) {
+      const vec2 corner { static_cast<float>(c & 1 ? x1 : x0), static_cast<float>(c & 2 ? y1 : y0) };
+      spread = glm::max(spread, length(primary_dir(frame, corner) - centre));
+    }
+    tiles.init(frame.scene, frame.camera_pos, centre, spread, frame.rmp.max_dist);
+    if (!prune) tiles.num_slabs = 0; // every ray stays on the whole tape
+  }
+
+  // where the rays of each PREPASS_FINE block start, 0 without the prepass
+  float start[CPU_TILE_SIZE / PREPASS_FINE][CPU_TILE_SIZE / PREPASS_FINE] {};
+  if (frame.rmp.prepass) prepass(x0, y0, start);
+
+  vec4 totals { 0.0f };
+  auto add_totals = [this, &totals] () {
+    march_steps.fetch_add(static_cast<uint64_t>(totals.x), std::memory_order_relaxed);
+    shadow_steps.fetch_add(static_cast<uint64_t>(totals.y), std::memory_order_relaxed);
+    sdf_calls.fetch_add(static_cast<uint64_t>(totals.z), std::memory_order_relaxed);
+    brick_steps.fetch_add(static_cast<uint64_t>(totals.w), std::memory_order_relaxed);
+    march_instructions.fetch_add(tiles.instructions, std::memory_order_relaxed);
+  };
+
+  if (!packets) {
+    for (int y = y0; y < y1; ++y) {
+      for (int x = x0; x < x1; ++x) {
+        // sample at the pixel centre like gl_FragCoord
+        vec4 stats;
+        const vec4 col { shade_pixel(frame, vec2(x + 0.5f, y + 0.5f),
+                                     start[(y - y0) / PREPASS_FINE][(x - x0) / PREPASS_FINE], stats, &tiles) };
+        store_pixel(x, y, col, stats);
+        totals += stats;
+      }
+    }
+    add_totals();
+    return;
+  }
+
+  // small blocks keep the rays of a packet close together so they take similar paths
+  for (int py = y0; py < y1; py += PACKET_H) {
+    for (int px = x0; px < x1; px += PACKET_W) {
+      float fx[SIMD_WIDTH], fy[SIMD_WIDTH], fs[SIMD_WIDTH];
+      for (int i = 0; i < SIMD_WIDTH; ++i) {
+        fx[i] = static_cast<float>(px + i % PACKET_W) + 0.5f;
+        fy[i] = static_cast<float>(py + i / PACKET_W) + 0.5f;
+        fs[i] = start[(py + i / PACKET_W - y0) / PREPASS_FINE][(px + i % PACKET_W - x0) / PREPASS_FINE];
+      }
+
+      vfloat      packet_steps { 0.0f }, packet_shadow_steps { 0.0f }, packet_brick_steps { 0.0f };
+      const vvec3 col { shade_packet(frame, vfloat::load(fx), vfloat::load(fy), vfloat::load(fs),
+                                     packet_steps, packet_shadow_steps, packet_brick_steps, &tiles) };
+      float r[SIMD_WIDTH], g[SIMD_WIDTH], b[SIMD_WIDTH], s[SIMD_WIDTH], ss[SIMD_WIDTH], bs[SIMD_WIDTH];
+      col.x.store(r);
+      col.y.store(g);
+      col.z.store(b);
+      packet_steps.store(s);
+      packet_shadow_steps.store(ss);
+      packet_brick_steps.store(bs);
+
+      for (int i = 0; i < SIMD_WIDTH; ++i) {
+        const int x { px + i % PACKET_W };
+        const int y { py + i / PACKET_W };
+        if (x < x1 && y < y1) {
+          // calls of this lane only, like the scalar path
+          const vec4 stats { s[i], ss[i], s[i] + ss[i] - bs[i] + 1.0f, bs[i] };
+          store_pixel(x, y, vec4(r[i], g[i], b[i], 1.0f), stats);
+          totals += stats;
+        }
+      }
+    }
+  }
+  add_totals();
+}
+
+// fragment.glsl's prepasses over the tile at x0, y0. each pixel of them cone marches the ray
+// through the middle of the ones it covers, the fine pass starts where its coarse pixel stopped
+void cpu_renderer_t::prepass(int x0, int y0, float start[CPU_TILE_SIZE / PREPASS_FINE][CPU_TILE_SIZE / PREPASS_FINE]) {
+  constexpr int coarse_n { CPU_TILE_SIZE / PREPASS_COARSE };
+  constexpr int fine_n   { CPU_TILE_SIZE / PREPASS_FINE };
+  constexpr int nested   { PREPASS_COARSE / PREPASS_FINE };
+
+  int   steps { 0 };
+  float coarse[coarse_n][coarse_n];
+  for (int y = 0; y < coarse_n; ++y) {
+    for (int x = 0; x < coarse_n; ++x) {
+      const vec2 frag_coord { x0 + (x + 0.5f) * PREPASS_COARSE, y0 + (y + 0.5f) * PREPASS_COARSE };
+      coarse[y][x] = cone_march(frame, frame.camera_pos, primary_dir(frame, frag_coord), 0.0f,
+                                PREPASS_COARSE * 0.7072f / frame.resolution.y, steps);
+    }
+  }
+  for (int y = 0; y < fine_n; ++y) {
+    for (int x = 0; x < fine_n; ++x) {
+      const vec2 frag_coord { x0 + (x + 0.5f) * PREPASS_FINE, y0 + (y + 0.5f) * PREPASS_FINE };
+      start[y][x] = cone_march(frame, frame.camera_pos, primary_dir(frame, frag_coord), coarse[y / nested][x / nested],
+                               PREPASS_FINE * 0.7072f / frame.resolution.y, steps);
+    }
+  }
+  prepass_steps.fetch_add(static_cast<uint64_t>(steps), std::memory_order_relaxed);
+}
+
+void cpu_renderer_t::store_pixel(int x, int y, vec4 col, vec4 stats) {
+  const size_t idx { static_cast<size_t>(y) * target->width + x };
+
+  for (int i = 0; i < 4; ++i)
+    target->stats[idx * 4 + i] = stats[i];
+  if (frame.rmp.heatmap > HEATMAP_OFF)
+    col = vec4(heat(stats[frame.rmp.heatmap - 1] / frame.rmp.heatmap_max), 1.0f);
+
+  if (target->format == CPU_FORMAT_RGBA8) {
+    uint8_t* px { static_cast<uint8_t*>(target->pixels) + idx * 4 };
+    for (int i = 0; i < 4; ++i)
+      px[i] = static_cast<uint8_t>(clamp(col[i], 0.0f, 1.0f) * 255.0f + 0.5f);
+  } else {
+    float* px { static_cast<float*>(target->pixels) + idx * 4 };
+    for (int i = 0; i < 4; ++i)
+      px[i] = col[i];
+  }
+}
@@ -0,0 +1,143 @@
+#ifndef _CPU_RENDERER_H_
+#define _CPU_RENDERER_H_
+
+#include "main.hpp"
+#include "sdf.hpp"
+#include "scene.hpp"
+#include "bvh.hpp"
+#include "brick_map.hpp"
+#include "scheduler.hpp"
+
+#define CPU_TILE_SIZE 16
+// a tile runs the prepasses of its own pixels
+#if CPU_TILE_SIZE % PREPASS_COARSE != 0 || PREPASS_COARSE % PREPASS_FINE != 0
+#error "prepass pixels have to nest inside tiles"
+#endif
+
+// pixel block marched as one packet, must divide CPU_TILE_SIZE
+#if SIMD_WIDTH == 8
+#define PACKET_W 4
+#define PACKET_H 2
+#elif SIMD_WIDTH == 4
+#define PACKET_W 2
+#define PACKET_H 2
+#else
+#define PACKET_W 1
+#define PACKET_H 1
+#endif
+
+// primary rays march on the scene's tape pruned to their tile and a slab of distance along it,
+// slabs end at CPU_SLAB_FIRST * CPU_SLAB_RATIO^k and the last one at max_dist
+#define CPU_SLAB_FIRST 1.0f
+#define CPU_SLAB_RATIO 1.25f
+#define CPU_MAX_SLABS  64
+
+enum cpu_format_t {
+  CPU_FORMAT_RGBA8 = 0,
+  CPU_FORMAT_RGBA32F
+};
+
+// pixels are stored bottom row first, same as a GL framebuffer
+struct cpu_framebuffer_t {
+  int          width  { 0 };
+  int          height { 0 };
+  cpu_format_t format { CPU_FORMAT_RGBA8 };
+  void*        pixels { nullptr };
+  float*       stats  { nullptr }; // 4 floats per pixel laid out like frag_stats
+
+  void   resize      (int, int, cpu_format_t);
+  size_t pixel_size  (void) const;
+  ~cpu_framebuffer_t (void);
+};
+
+// the scene's tape for each shell around the camera that no lod node switches inside, for the
+// queries that leave the tile: shadow rays, normals, and primary rays without pruning
+struct lod_tapes_t {
+  const scene_t*                          scene { nullptr };
+  vec3                                    eye   {};
+  std::vector<float>                      ends;  // shell k is [ends[k - 1], ends[k]), the last one is open
+  std::vector<std::vector<scene_instr_t>> tapes; // one more than ends
+
+  bool init (const scene_t*, vec3); // false when the scene has no lod nodes
+  const std::vector<scene_instr_t>& shell (float) const; // for points t from the camera
+  const std::vector<scene_instr_t>& at (vec3) const;
+  // the whole scene's when the lanes are in different shells
+  const std::vector<scene_instr_t>& at (const vvec3&) const;
+};
+
+// everything a worker needs to shade a frame, the same inputs shader_t::run takes
+// plus the scene shader_t has compiled in
+struct cpu_frame_t {
+  const scene_t*     scene  { nullptr };
+  const scene_bvh_t* bvh    { nullptr }; // queries of the whole scene go through it when set
+  const brick_map_t* bricks { nullptr }; // marchers step on it far from surfaces when set
+  const lod_tapes_t* lod    { nullptr }; // queries of the whole scene run its tapes when set
+  bool               segment { false }; // marchers segment trace on scene->eval_bound
+  ray_march_params_t rmp;
+  vec4               slider;
+  vec3               camera_pos;
+  vec2               mouse;
+  vec2               resolution;
+};
+
+// the pruned tapes of one tile, built the first time a ray reaches their slab. the rays of the
+// tile stay inside a cone around centre_dir, the ball of a slab holds that cone's section
+struct tile_tapes_t {
+  const scene_t*             scene     { nullptr };
+  vec3                       origin    {};
+  vec3                       centre_dir{};
+  float                      spread    { 0.0f }; // largest |dir - centre_dir| over the tile
+  uint64_t                   instructions { 0 }; // ran by the primary rays, for march_instructions
+  int                        num_slabs { 0 };
+  float                      slab_end[CPU_MAX_SLABS];
+  bool                       built[CPU_MAX_SLABS];
+  bool                       pair_built[CPU_MAX_SLABS];
+  std::vector<scene_instr_t> tapes[CPU_MAX_SLABS];
+  std::vector<scene_instr_t> pair_tapes[CPU_MAX_SLABS]; // slab k and k + 1
+
+  void init  (const scene_t*, vec3, vec3, float, float); // max_dist last
+  void prune (int, int, std::vector<scene_instr_t>&) const; // first and last slab
+  const std::vector<scene_instr_t>& slab (int);
+  const std::vector<scene_instr_t>& pair (int);
+  // the tape for points at distance t, the whole scene's outside the slabs
+  const std::vector<scene_instr_t>& at   (float);
+  // the same for a packet, the whole scene when its active lanes are in different slabs
+  const std::vector<scene_instr_t>& at   (vfloat, vmask);
+};
+
+struct cpu_renderer_t {
+  scheduler_t        scheduler;
+
+  int                tiles_x { 0       };
+  cpu_frame_t        frame   {};
+  scene_t            bound_scene; // the frame's scene with its sliders applied
+  cpu_framebuffer_t* target  { nullptr };
+  bool               packets { true    }; // false falls back to one ray at a time
+  bool               prune   { true    }; // primary rays march on tile_tapes_t
+  bool               bvh     { false   }; // the whole scene is evaluated through scene_bvh
+  bool               bricks  { false   }; // march on brick_map, baked through scene_bvh
+  bool               segment { false   }; // segment tracing instead of sphere tracing
+  scene_bvh_t        scene_bvh;
+  lod_tapes_t        lod_tapes;
+  brick_map_t        brick_map;
+  vec4               baked_slider { NAN }; // brick_map is rebaked when the sliders move
+  const scene_t*     baked_scene  { nullptr };
+
+  // totals of the last frame, like frag_stats.xyz summed over the frame
+  std::atomic<uint64_t> march_steps  { 0 };
+  std::atomic<uint64_t> shadow_steps { 0 };
+  std::atomic<uint64_t> sdf_calls    { 0 };
+  std::atomic<uint64_t> brick_steps  { 0 }; // of march_steps and shadow_steps, taken on brick_map
+  std::atomic<uint64_t> prepass_steps { 0 }; // cone steps of both prepasses, not in march_steps
+  // tape instructions primary rays ran over all their steps, lanes of a packet count each
+  std::atomic<uint64_t> march_instructions { 0 };
+
+  cpu_renderer_t  (int num_threads = 0); // 0 means one worker per core
+  void run        (cpu_framebuffer_t&, const scene_t&, ray_march_params_t, float [4], const camera_t&);
+
+  void draw_tile  (int);
+  void prepass    (int, int, float [CPU_TILE_SIZE / PREPASS_FINE][CPU_TILE_SIZE / PREPASS_FINE]); // tile corner
+  void store_pixel(int, int, vec4, vec4); // colour, stats
+};
+
+#endif // _CPU_RENDERER_H_
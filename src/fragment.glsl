@@ -5,11 +5,30 @@ uniform vec2 u_resolution;
 uniform int u_max_steps;
 uniform float u_max_dist;
 uniform float u_surf_dist;
+uniform float u_relaxation;
+uniform int u_shadow_steps;
+uniform float u_penumbra;
+// primary rays hit within this many pixel footprints, 1 / u_resolution.y per unit marched
+uniform float u_footprint;
 uniform vec4 u_slider;
 uniform vec3 u_camera_pos;
 uniform vec2 u_mouse;
-
-out vec4 frag_color;
+uniform int u_heatmap;
+uniform float u_heatmap_max;
+// full resolution pixels a side per pixel of this pass, 0 in the full resolution one,
+// and per texel of u_start, the start distances of the last prepass. 0 without one
+uniform int u_prepass;
+uniform sampler2D u_start;
+uniform int u_start_scale;
+
+layout(location = 0) out vec4 frag_color;
+// x: march steps of the primary ray, y: shadow ray steps, z: sdf_scene calls,
+// w: primary ray steps taken on the brick map
+// only stored when the framebuffer has a stats attachment
+layout(location = 1) out vec4 frag_stats;
+
+int sdf_calls = 0;
+int brick_steps = 0;
 
 vec3 light_pos = vec3(0., 15.,0.);
 
@@ -53,12 +72,36 @@ float Box(vec3 p, vec3 s) {
   return length(max(abs(p)-s, 0.));
 }
 
+// mesh_sdf_t volumes, scene_t::mesh_atlas lays their slots out x first
+uniform sampler3D u_meshes;
+
+// the volume's filtered sample at q, which is inside its cube
+float mesh_sample(vec3 q, vec3 lo, float cell, float slot, float samples) {
+  ivec3 size = textureSize(u_meshes, 0);
+  ivec3 slots = size / int(samples);
+  int s = int(slot);
+  vec3 base = vec3(s % slots.x, (s / slots.x) % slots.y, s / (slots.x * slots.y)) * samples;
+  return texture(u_meshes, (base + (q - lo) / cell + 0.5) / vec3(size)).r;
+}
+
+float Mesh(vec3 p, vec3 lo, float cell, float slot, float samples) {
+  vec3 q = clamp(p, lo, lo + cell * (samples - 1.));
+  float d = mesh_sample(q, lo, cell, slot, samples);
+  vec3 o = p - q;
+  return o == vec3(0.) ? d : sqrt(dot(o, o) + d * d);
+}
+
 mat2 Rotate(float a) {
   float s = sin(a);
   float c = cos(a);
   return mat2(c, -s, s, c);
 }
 
+// from the sin and cos in x and y, computed on the CPU for the scene's rotations
+mat2 Rotate(vec2 sc) {
+  return mat2(sc.y, -sc.x, sc.x, sc.y);
+}
+
 float d_minus(float b, float a) {
   return max(-a, b);
 }
@@ -76,31 +119,364 @@ float d_or_smooth(float a, float b, float k) {
   return mix(b, a, h) - k * h * (1.0 - h);
 }
 
-float sdf_scene(vec3 p) {
-  float h = 20;
-  
-  float d = p.y + h;
-  p.z -= h;
+// a level of detail: a while t, the point's distance from the camera, is below far, then b
+float d_lod(float a, float b, float t, float far) {
+  return t < far ? a : b;
+}
 
-  vec3 p_torus = p;
-  p_torus.xy *= Rotate(u_slider.w);
-  d = min(d, Torus(p_torus, vec2(7, .7)));
-  
-  vec3 p_box = p;
-  p_box     -= vec3(0., 1., 0.);   // translation
-  p_box     *= .75;                // scaling
-  p_box.xy  *= Rotate(1.7);          // rotation
-  
-  float d_box   = Box(p_box, vec3(.8));
-  float d_cyl   = Cylinder(p, u_slider.xyz, u_slider.xyz + vec3(0.,5.5,0.), .5);
-  float d_sph   = Sphere(p-vec3(0.,1.5,0.), 1.);
-  float d_shape = d_minus(d_or_smooth(d_box, d_cyl, 2.),
-                          d_sph);
-  
-  d = d_or(d, d_shape);
+// dual numbers: x is the distance and yzw its gradient in p, differentiated by hand from the
+// functions above so a hit's normal takes one evaluation of the scene
+vec4 Sphere_dual(vec3 p, float r) {
+  float l = length(p);
+  return vec4(l - r, p / l);
+}
+
+vec4 Capsule_dual(vec3 p, vec3 a, vec3 b, float r) {
+  vec3 ab = b - a;
+  vec3 ap = p - a;
+  vec3 o = p - (a + clamp(dot(ab, ap) / dot(ab, ab), 0., 1.) * ab);
+  float l = length(o);
+  return vec4(l - r, o / l);
+}
+
+vec4 Cylinder_dual(vec3 p, vec3 a, vec3 b, float r) {
+  vec3 ab = b - a;
+  vec3 ap = p - a;
+  float t = dot(ab, ap) / dot(ab, ab);
+  vec3 o = p - (a + t * ab);
+  vec4 x = vec4(length(o) - r, normalize(o));
+  vec4 y = vec4((abs(t - 0.5) - 0.5) * length(ab), sign(t - 0.5) * normalize(ab));
+  vec2 m = max(vec2(x.x, y.x), 0.);
+  float l = length(m);
+  if (l > 0.) return vec4(l, (m.x * x.yzw + m.y * y.yzw) / l);
+  return x.x > y.x ? x : y;
+}
+
+vec4 Torus_dual(vec3 p, vec2 r) {
+  float l = length(p.xz);
+  vec2 q = vec2(l - r.x, p.y);
+  float lq = length(q);
+  return vec4(lq - r.y, vec3(p.x * q.x / l, q.y, p.z * q.x / l) / lq);
+}
+
+// flat inside, so the gradient is zero there
+vec4 Box_dual(vec3 p, vec3 s) {
+  vec3 m = max(abs(p)-s, 0.);
+  float l = length(m);
+  return vec4(l, l > 0. ? sign(p) * m / l : vec3(0.));
+}
+
+// central differences of the samples half a cell either side, the volume has no closed form
+vec4 Mesh_dual(vec3 p, vec3 lo, float cell, float slot, float samples) {
+  vec3 hi = lo + cell * (samples - 1.);
+  vec3 q = clamp(p, lo, hi);
+  float d = mesh_sample(q, lo, cell, slot, samples);
+  vec3 g;
+  for (int i = 0; i < 3; ++i) {
+    vec3 e = vec3(0.);
+    e[i] = 0.5 * cell;
+    vec3 a = min(q + e, hi);
+    vec3 b = max(q - e, lo);
+    g[i] = (mesh_sample(a, lo, cell, slot, samples) - mesh_sample(b, lo, cell, slot, samples)) / (a[i] - b[i]);
+  }
+  vec3 o = p - q;
+  if (o == vec3(0.)) return vec4(d, g);
+  float l = sqrt(dot(o, o) + d * d);
+  return vec4(l, (o + d * g * vec3(equal(p, q))) / l);
+}
+
+vec4 d_minus(vec4 b, vec4 a) {
+  return -a.x > b.x ? -a : b;
+}
+
+vec4 d_and(vec4 a, vec4 b) {
+  return a.x > b.x ? a : b;
+}
+
+vec4 d_or(vec4 a, vec4 b) {
+  return a.x < b.x ? a : b;
+}
+
+// where the blend is smooth the h terms of the gradient cancel, leaving the mix of the two
+vec4 d_or_smooth(vec4 a, vec4 b, float k) {
+  float h = clamp(0.5 + 0.5 * (b.x - a.x) / k, 0., 1.);
+  return mix(b, a, h) - vec4(k * h * (1.0 - h), 0., 0., 0.);
+}
+
+vec4 d_lod(vec4 a, vec4 b, float t, float far) {
+  return t < far ? a : b;
+}
+
+// bounds of a distance over a ball and in z its Lipschitz bound there, for segment tracing.
+// a primitive at r from the ball's centre changes by at most lipschitz * r, and scale is how
+// much its point was scaled from the scene's. an operator only takes the bound of the children
+// that can decide its distance in the ball, where they might both it's the larger one: the
+// blend's gradient is a mix of theirs
+vec3 d_bound(float d, float r, float lipschitz, float scale) {
+  float e = lipschitz * r + 1e-4 + 1e-5 * abs(d);
+  return vec3(d - e, d + e, lipschitz * scale);
+}
+
+vec3 d_minus(vec3 b, vec3 a) {
+  return vec3(max(-a.y, b.x), max(-a.x, b.y), -a.x < b.x ? b.z : max(a.z, b.z));
+}
+
+vec3 d_and(vec3 a, vec3 b) {
+  return vec3(max(a.x, b.x), max(a.y, b.y), a.y < b.x ? b.z : b.y < a.x ? a.z : max(a.z, b.z));
+}
+
+vec3 d_or(vec3 a, vec3 b) {
+  return vec3(min(a.x, b.x), min(a.y, b.y), a.x > b.y ? b.z : b.x > a.y ? a.z : max(a.z, b.z));
+}
+
+vec3 d_or_smooth(vec3 a, vec3 b, float k) {
+  float l = a.x - b.y >= k ? b.z : b.x - a.y >= k ? a.z : max(a.z, b.z);
+  return vec3(min(a.x, b.x) - 0.25 * abs(k), min(a.y, b.y), l);
+}
+
+// a ball of radius r at t that straddles far could get either distance
+vec3 d_lod(vec3 a, vec3 b, float t, float r, float far) {
+  if (t + r < far) return a;
+  if (t - r >= far) return b;
+  return vec3(min(a.x, b.x), max(a.y, b.y), max(a.z, b.z));
+}
 
+// shader_t replaces this line with sdf_graph(), generated from the scene_t (scene.hpp),
+// or with the defines for the tape interpreter below (scene_tape_glsl). with tile culling
+// (tile_cull.hpp) or the bvh (bvh.hpp) it also gets sdf_object(i, p) for the scene's objects
+#pragma sdf_scene
+
+#ifdef SDF_TAPE
+// scene_t::pack_tape, three vec4 per instruction: (op, out, a, b), v0..v3, v4..v6
+layout(std140) uniform tape_block {
+  vec4 u_tape[3*TAPE_LENGTH];
+};
+uniform int u_tape_length;
+
+float sdf_graph(vec3 p) {
+  float d[TAPE_REGS];
+  vec3 q[TAPE_REGS];
+  q[0] = p;
+  d[0] = 1e10;
+
+  for (int i = 0; i < u_tape_length; ++i) {
+    ivec4 op = ivec4(u_tape[3*i]);
+    vec4 v = u_tape[3*i + 1];
+    vec4 w = u_tape[3*i + 2];
+    vec3 r = q[op.z];
+
+    switch (op.x) {
+    case OP_PLANE:     d[op.y] = dot(r, v.xyz) + v.w; break;
+    case OP_SPHERE:    d[op.y] = Sphere(r, v.x); break;
+    case OP_CAPSULE:   d[op.y] = Capsule(r, v.xyz, vec3(v.w, w.xy), w.z); break;
+    case OP_CYLINDER:  d[op.y] = Cylinder(r, v.xyz, vec3(v.w, w.xy), w.z); break;
+    case OP_TORUS:     d[op.y] = Torus(r, v.xy); break;
+    case OP_BOX:       d[op.y] = Box(r, v.xyz); break;
+    case OP_MESH:      d[op.y] = Mesh(r, v.xyz, v.w, w.x, w.y); break;
+
+    case OP_OR:        d[op.y] = d_or(d[op.z], d[op.w]); break;
+    case OP_AND:       d[op.y] = d_and(d[op.z], d[op.w]); break;
+    case OP_MINUS:     d[op.y] = d_minus(d[op.z], d[op.w]); break;
+    case OP_OR_SMOOTH: d[op.y] = d_or_smooth(d[op.z], d[op.w], v.x); break;
+    case OP_LOD:       d[op.y] = d_lod(d[op.z], d[op.w], length(p - u_camera_pos), v.x); break;
+
+    case OP_TRANSLATE: q[op.y] = r - v.xyz; break;
+    case OP_SCALE:     q[op.y] = r * v.x; break;
+    case OP_ROTATE:    q[op.y] = vec3(r.x*v.z - r.y*v.y, r.x*v.y + r.y*v.z, r.z); break;
+    case OP_TRANSFORM: {
+      vec3 t = r - v.xyz;
+      q[op.y] = vec3(t.x*w.z - t.y*w.y, t.x*w.y + t.y*w.z, t.z) * v.w;
+    } break;
+    }
+  }
+  return d[0];
+}
+
+// the gradient of a primitive's dual at q, back in the scene's point p through dq/dp
+vec4 dual_chain(vec4 e, mat3 j) {
+  return vec4(e.x, e.yzw * j);
+}
+
+// the same with dual numbers, j keeps each point register's jacobian with respect to p
+vec4 sdf_graph_dual(vec3 p) {
+  vec4 d[TAPE_REGS];
+  vec3 q[TAPE_REGS];
+  mat3 j[TAPE_REGS];
+  q[0] = p;
+  j[0] = mat3(1.);
+  d[0] = vec4(1e10, 0., 0., 0.);
+
+  for (int i = 0; i < u_tape_length; ++i) {
+    ivec4 op = ivec4(u_tape[3*i]);
+    vec4 v = u_tape[3*i + 1];
+    vec4 w = u_tape[3*i + 2];
+    vec3 r = q[op.z];
+
+    switch (op.x) {
+    case OP_PLANE:     d[op.y] = dual_chain(vec4(dot(r, v.xyz) + v.w, v.xyz), j[op.z]); break;
+    case OP_SPHERE:    d[op.y] = dual_chain(Sphere_dual(r, v.x), j[op.z]); break;
+    case OP_CAPSULE:   d[op.y] = dual_chain(Capsule_dual(r, v.xyz, vec3(v.w, w.xy), w.z), j[op.z]); break;
+    case OP_CYLINDER:  d[op.y] = dual_chain(Cylinder_dual(r, v.xyz, vec3(v.w, w.xy), w.z), j[op.z]); break;
+    case OP_TORUS:     d[op.y] = dual_chain(Torus_dual(r, v.xy), j[op.z]); break;
+    case OP_BOX:       d[op.y] = dual_chain(Box_dual(r, v.xyz), j[op.z]); break;
+    case OP_MESH:      d[op.y] = dual_chain(Mesh_dual(r, v.xyz, v.w, w.x, w.y), j[op.z]); break;
+
+    case OP_OR:        d[op.y] = d_or(d[op.z], d[op.w]); break;
+    case OP_AND:       d[op.y] = d_and(d[op.z], d[op.w]); break;
+    case OP_MINUS:     d[op.y] = d_minus(d[op.z], d[op.w]); break;
+    case OP_OR_SMOOTH: d[op.y] = d_or_smooth(d[op.z], d[op.w], v.x); break;
+    case OP_LOD:       d[op.y] = d_lod(d[op.z], d[op.w], length(p - u_camera_pos), v.x); break;
+
+    case OP_TRANSLATE: q[op.y] = r - v.xyz; j[op.y] = j[op.z]; break;
+    case OP_SCALE:     q[op.y] = r * v.x; j[op.y] = j[op.z] * v.x; break;
+    case OP_ROTATE:
+      q[op.y] = vec3(r.x*v.z - r.y*v.y, r.x*v.y + r.y*v.z, r.z);
+      j[op.y] = mat3(v.z, v.y, 0., -v.y, v.z, 0., 0., 0., 1.) * j[op.z];
+      break;
+    case OP_TRANSFORM: {
+      vec3 t = r - v.xyz;
+      q[op.y] = vec3(t.x*w.z - t.y*w.y, t.x*w.y + t.y*w.z, t.z) * v.w;
+      j[op.y] = mat3(w.z, w.y, 0., -w.y, w.z, 0., 0., 0., 1.) * j[op.z] * v.w;
+    } break;
+    }
+  }
+  return d[0];
+}
+
+// the same over the ball (p, radius), see d_bound(). s keeps each point register's radius and
+// how much it was scaled from p
+vec3 sdf_graph_bound(vec3 p, float radius) {
+  vec3 d[TAPE_REGS];
+  vec3 q[TAPE_REGS];
+  vec2 s[TAPE_REGS];
+  q[0] = p;
+  s[0] = vec2(radius, 1.);
+  d[0] = vec3(1e10, 1e10, 0.);
+
+  for (int i = 0; i < u_tape_length; ++i) {
+    ivec4 op = ivec4(u_tape[3*i]);
+    vec4 v = u_tape[3*i + 1];
+    vec4 w = u_tape[3*i + 2];
+    vec3 r = q[op.z];
+    vec2 e = s[op.z];
+
+    switch (op.x) {
+    case OP_PLANE:     d[op.y] = d_bound(dot(r, v.xyz) + v.w, e.x, length(v.xyz), e.y); break;
+    case OP_SPHERE:    d[op.y] = d_bound(Sphere(r, v.x), e.x, 1., e.y); break;
+    case OP_CAPSULE:   d[op.y] = d_bound(Capsule(r, v.xyz, vec3(v.w, w.xy), w.z), e.x, 1., e.y); break;
+    case OP_CYLINDER:  d[op.y] = d_bound(Cylinder(r, v.xyz, vec3(v.w, w.xy), w.z), e.x, 1., e.y); break;
+    case OP_TORUS:     d[op.y] = d_bound(Torus(r, v.xy), e.x, 1., e.y); break;
+    case OP_BOX:       d[op.y] = d_bound(Box(r, v.xyz), e.x, 1., e.y); break;
+    case OP_MESH:      d[op.y] = d_bound(Mesh(r, v.xyz, v.w, w.x, w.y), e.x, 1.7320508, e.y); break;
+
+    case OP_OR:        d[op.y] = d_or(d[op.z], d[op.w]); break;
+    case OP_AND:       d[op.y] = d_and(d[op.z], d[op.w]); break;
+    case OP_MINUS:     d[op.y] = d_minus(d[op.z], d[op.w]); break;
+    case OP_OR_SMOOTH: d[op.y] = d_or_smooth(d[op.z], d[op.w], v.x); break;
+    case OP_LOD:       d[op.y] = d_lod(d[op.z], d[op.w], length(p - u_camera_pos), radius, v.x); break;
+
+    case OP_TRANSLATE: q[op.y] = r - v.xyz; s[op.y] = e; break;
+    case OP_SCALE:     q[op.y] = r * v.x; s[op.y] = e * abs(v.x); break;
+    case OP_ROTATE:    q[op.y] = vec3(r.x*v.z - r.y*v.y, r.x*v.y + r.y*v.z, r.z); s[op.y] = e; break;
+    case OP_TRANSFORM: {
+      vec3 t = r - v.xyz;
+      q[op.y] = vec3(t.x*w.z - t.y*w.y, t.x*w.y + t.y*w.z, t.z) * v.w;
+      s[op.y] = e * abs(v.w);
+    } break;
+    }
+  }
+  return d[0];
+}
+#endif
+
+#ifdef SDF_CULL
+// tile_cull_t::lists: per tile the offset and length of its list of sdf_object indices
+uniform usamplerBuffer u_tile_lists;
+uniform int u_tiles_x;
+
+bool culled = false; // only while the primary ray marches, shadow rays leave the tile
+int tile_first = 0;
+int tile_count = 0;
+
+float sdf_tile(vec3 p) {
+  float d = 1e10;
+  for (int i = 0; i < tile_count; ++i)
+    d = min(d, sdf_object(int(texelFetch(u_tile_lists, tile_first + i).r), p));
   return d;
 }
+#endif
+
+#ifdef SDF_BVH
+// scene_bvh_t::texels, per node (centre, alpha) and (beta, first child or -1, object, 0).
+// everything under a node is at least (|p - centre| - alpha) / beta away
+uniform samplerBuffer u_bvh;
+
+float bvh_lower(int node, vec3 p) {
+  vec4 b = texelFetch(u_bvh, 2 * node);
+  return (length(p - b.xyz) - b.w) / texelFetch(u_bvh, 2 * node + 1).x;
+}
+
+int bvh_nearest = -1; // the object sdf_bvh found closest, whose gradient is the scene's
+
+// nodes are skipped once the best distance is below their bound, the nearer child goes first
+float sdf_bvh(vec3 p) {
+  int   stack[BVH_STACK];
+  float lower[BVH_STACK];
+  int   top = 1;
+  float d   = 1e10;
+  stack[0] = 0;
+  lower[0] = -1e10;
+
+  while (top > 0) {
+    --top;
+    if (lower[top] >= d) continue;
+    vec4 n = texelFetch(u_bvh, 2 * stack[top] + 1);
+    if (n.y < 0.) {
+      float o = sdf_object(int(n.z), p);
+      if (o < d) {
+        d = o;
+        bvh_nearest = int(n.z);
+      }
+      continue;
+    }
+    int   c  = int(n.y);
+    float a  = bvh_lower(c, p);
+    float b  = bvh_lower(c + 1, p);
+    bool  an = a <= b;
+    stack[top] = an ? c + 1 : c;
+    lower[top] = an ? b : a;
+    ++top;
+    stack[top] = an ? c : c + 1;
+    lower[top] = an ? a : b;
+    ++top;
+  }
+  return d;
+}
+#endif
+
+float sdf_scene(vec3 p) {
+  ++sdf_calls;
+#ifdef SDF_CULL
+  if (culled) return sdf_tile(p);
+#endif
+#ifdef SDF_BVH
+  return sdf_bvh(p);
+#else
+  return sdf_graph(p);
+#endif
+}
+
+// sdf_scene() and its gradient in one pass, the bvh's is the nearest object's
+vec4 sdf_scene_dual(vec3 p) {
+  ++sdf_calls;
+#ifdef SDF_BVH
+  bvh_nearest = -1;
+  float d = sdf_bvh(p);
+  return bvh_nearest < 0 ? vec4(d, 0., 0., 0.) : sdf_object_dual(bvh_nearest, p);
+#else
+  return sdf_graph_dual(p);
+#endif
+}
 
 float sdf_scene2(vec3 p) {
   p.x = abs(p.x);
@@ -132,37 +508,193 @@ float sdf_scene2(vec3 p) {
   return d;
 }
 
-float ray_march(vec3 ro, vec3 rd) {
-  float d = 0.;
+#ifdef SDF_BRICKS
+// brick_map_t: corner samples of the coarse cells, per cell its atlas slot (or -1 where the
+// coarse samples do, -2 where the scene has to be evaluated) and the bricks' samples
+uniform sampler3D u_brick_coarse;
+uniform isampler3D u_brick_index;
+uniform sampler3D u_brick_atlas;
+uniform vec3 u_brick_lo;
+uniform float u_brick_cell;
+
+// lower bound of the distance at p, the filtered samples less BRICK_MARGIN voxels
+float brick_bound(vec3 p) {
+  if (u_brick_cell <= 0.) return -1e10;
+  vec3 g = (p - u_brick_lo) / u_brick_cell;
+  ivec3 cells = textureSize(u_brick_index, 0);
+  if (any(lessThan(g, vec3(0.))) || any(greaterThanEqual(g, vec3(cells)))) return -1e10;
+
+  ivec3 c = min(ivec3(g), cells - 1);
+  int slot = texelFetch(u_brick_index, c, 0).r;
+  if (slot == -1)
+    return texture(u_brick_coarse, (g + 0.5) / vec3(cells + 1)).r - BRICK_MARGIN * u_brick_cell;
+  if (slot < 0) return -1e10;
+
+  ivec3 size  = textureSize(u_brick_atlas, 0);
+  ivec3 slots = size / (BRICK_SIZE + 1);
+  vec3  local = (g - vec3(c)) * float(BRICK_SIZE);
+  vec3  base  = vec3(ivec3(slot % slots.x, (slot / slots.x) % slots.y, slot / (slots.x * slots.y)) * (BRICK_SIZE + 1));
+  return texture(u_brick_atlas, (base + local + 0.5) / vec3(size)).r - BRICK_MARGIN * u_brick_cell / float(BRICK_SIZE);
+}
+#endif
+
+#ifdef SDF_SEGMENT
+// segment tracing, after Galin et al.: the step is the distance over the Lipschitz bound of the
+// segment ahead, SEGMENT_GROWTH times the distance long, and never leaves it. only the branches
+// that can decide the distance along it count, so scaled and blended subtrees slow down the
+// rays that pass them and no others. the brick map's bounds assume a 1-Lipschitz scene, it
+// isn't used
+float segment_march(vec3 ro, vec3 rd, float start, inout int steps) {
+  float d = start;
+  float pixel = u_footprint / u_resolution.y;
 
   for (int i = 0; i < u_max_steps; ++i) {
+    ++steps;
     vec3 p = ro + rd * d;
     float ds = sdf_scene(p);
-    d += ds;
-    if (d > u_max_dist || ds < u_surf_dist) break;
+    if (ds < max(u_surf_dist, d * pixel)) {
+      d += ds;
+      break;
+    }
+    float s = ds * SEGMENT_GROWTH;
+    float l = sdf_graph_bound(p + rd * (s * 0.5), s * 0.5).z;
+    d += min(ds / l, s);
+    if (d > u_max_dist) break;
   }
 
   return d;
 }
+#endif
+
+// over-relaxed sphere tracing (Keinert et al. 2014): steps are u_relaxation times the distance.
+// once the ball at the new point and the one it stepped from stop overlapping the step may
+// have jumped over a surface, so it goes back to the plain step and marches plainly until the
+// distance grows again
+float ray_march(vec3 ro, vec3 rd, float start, inout int steps) {
+#ifdef SDF_SEGMENT
+  return segment_march(ro, rd, start, steps);
+#else
+  float d = start;
+  float w = u_relaxation;
+  float step = 0.;
+  float prev = 0.; // the last distance
+  // once the pixel's cone is wider than u_surf_dist, a surface inside it is as good as hit
+  float pixel = u_footprint / u_resolution.y;
+#ifdef SDF_BRICKS
+  // brick_map_t::near, bounds below a voxel would have grazing rays crawl along the surface
+  float near = max(u_brick_cell / float(BRICK_SIZE), u_surf_dist);
+#endif
+
+  for (int i = 0; i < u_max_steps; ++i) {
+    ++steps;
+    vec3 p = ro + rd * d;
+#ifdef SDF_BRICKS
+    float b = brick_bound(p);
+    if (b > near) {
+      ++brick_steps;
+      // the bound holds for the point it was taken at, a relaxed step may have jumped a surface
+      if (w > 1. && b + prev < step) {
+        d += prev - step;
+        w = 1.;
+        continue;
+      }
+      d += b;
+      step = prev = b;
+      if (d > u_max_dist) break;
+      continue;
+    }
+#endif
+    float ds = sdf_scene(p);
+    bool missed = w > 1. && abs(ds) + prev < step;
+    if (missed) {
+      d += prev - step;
+      w = 1.;
+      continue;
+    }
+    if (ds < max(u_surf_dist, d * pixel)) {
+      d += ds;
+      break;
+    }
+    if (ds > prev) w = u_relaxation; // moving away from what it backed off from
+    step = ds * w;
+    prev = abs(ds);
+    d += step;
+    if (d > u_max_dist) break;
+  }
+
+  return d;
+#endif
+}
+
+// how far every ray within slope k of rd gets before one of them could reach a surface. a ray's
+// point at t is within t * k of rd's, so the ball at rd's point covers the cone's section for a
+// step of (ds - t * k) / (1 + k). plain steps, the rays inside march the rest with relaxation
+float cone_march(vec3 ro, vec3 rd, float start, float k, inout int steps) {
+  float d = start;
+
+  for (int i = 0; i < u_max_steps; ++i) {
+    ++steps;
+    vec3 p = ro + rd * d;
+    float ds = sdf_scene(p);
+#ifdef SDF_SEGMENT
+    // the ball at p is still empty out to ds over the bound around it
+    ds /= max(sdf_graph_bound(p, ds).z, 1.);
+#endif
+    float r = d * k;
+    if (ds < r + u_surf_dist) break;
+    d += (ds - r) / (1. + k);
+    if (d > u_max_dist) break;
+  }
+
+  return min(d, u_max_dist);
+}
 
 vec3 normal(vec3 p) {
-  const vec2 e = vec2(0.01, 0);
-  return normalize(sdf_scene(p) - vec3(sdf_scene(p-e.xyy),
-                                       sdf_scene(p-e.yxy),
-                                       sdf_scene(p-e.yyx)));
+  return normalize(sdf_scene_dual(p).yzw);
 }
 
-float get_light(vec3 p) {
+// how much of the light reaches ro, 0 in the umbra. plain steps up to the light and no further.
+// the smallest u_penumbra * distance / t along the way is how much of a cone around the ray is
+// clear of the scene, the penumbra comes from the distances the march takes anyway (Quilez).
+// the brick map's bounds fall short of the distance by up to most of a cell and would darken
+// it, shadow rays don't use the map
+float shadow_march(vec3 ro, vec3 rd, float max_t, inout int steps) {
+  float res = 1.;
+  float t = 0.;
+
+  for (int i = 0; i < u_shadow_steps && t < max_t; ++i) {
+    ++steps;
+    vec3 p = ro + rd * t;
+    float h = sdf_scene(p);
+    if (h < u_surf_dist) return 0.;
+#ifdef SDF_SEGMENT
+    float s = h * SEGMENT_GROWTH;
+    h = min(h / sdf_graph_bound(p + rd * (s * 0.5), s * 0.5).z, s);
+#endif
+    res = min(res, u_penumbra * h / max(t, u_surf_dist));
+    t += h;
+  }
+
+  return res;
+}
+
+float get_light(vec3 p, vec3 n, inout int shadow_steps) {
   vec3 l = normalize(light_pos - p);
-  vec3 n = normal(p);
-  
+
   float dif = clamp(dot(n, l), 0., 1.);
-  float d = ray_march(p + n * u_surf_dist * 2., l);
-  return dif * ((d < length(light_pos - p)) ? 0.1 : 1.0);
+  float lit = shadow_march(p + n * u_surf_dist * 2., l, length(light_pos - p), shadow_steps);
+  return dif * mix(0.1, 1.0, lit);
+}
+
+// blue - green - red, same ramp as heat() in cpu_renderer.cpp
+vec3 heat(float t) {
+  t = clamp(t, 0., 1.);
+  return clamp(vec3(4. * t - 2., 2. - abs(4. * t - 2.), 2. - 4. * t), 0., 1.);
 }
 
 void main () {
-  vec2 frag_coord = gl_FragCoord.xy;
+  // a prepass pixel marches the ray through the middle of the ones it covers
+  vec2 frag_coord = gl_FragCoord.xy * float(max(u_prepass, 1));
   vec2 uv = (frag_coord-0.5*u_resolution)/u_resolution.y;
   
   vec3 col = vec3(0);
@@ -181,11 +713,34 @@ void main () {
   vec3 i  = c + uv.x*r + uv.y*u;
   vec3 rd = normalize(i-ro);
 
-  float d = ray_march(ro, rd);
+  int   steps = 0;
+  float start = 0.;
+  if (u_start_scale > 0) start = texelFetch(u_start, ivec2(frag_coord) / u_start_scale, 0).r;
+  if (u_prepass > 0) {
+    // the pixels' rays are within half a diagonal of the middle one on the image plane at 1
+    frag_color = vec4(cone_march(ro, rd, start, float(u_prepass) * 0.7072 / u_resolution.y, steps));
+    return;
+  }
+#ifdef SDF_CULL
+  int tile = (int(frag_coord.y) / CULL_TILE) * u_tiles_x + int(frag_coord.x) / CULL_TILE;
+  tile_first = int(texelFetch(u_tile_lists, 2 * tile).r);
+  tile_count = int(texelFetch(u_tile_lists, 2 * tile + 1).r);
+  culled = true;
+#endif
+  float d = ray_march(ro, rd, start, steps);
   vec3  p = ro + rd * d;
-
-  float dif = get_light(p);
+#ifdef SDF_CULL
+  culled = false;
+#endif
+
+  // one normal for the lighting and the colour
+  vec3  n = normal(p);
+  int   shadow_steps = 0;
+  float dif = get_light(p, n, shadow_steps);
   col = vec3(dif);
-  col += normal(p) * -0.5;
+  col += n * -0.5;
+
+  frag_stats = vec4(float(steps), float(shadow_steps), float(sdf_calls), float(brick_steps));
+  if (u_heatmap > 0) col = heat(frag_stats[u_heatmap - 1] / u_heatmap_max);
   frag_color = vec4(col, 1.0);
 }
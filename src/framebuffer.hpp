@@ -0,0 +1,22 @@
+#ifndef _FRAMEBUFFER_H_
+#define _FRAMEBUFFER_H_
+
+#include "main.hpp"
+
+// offscreen RGBA8 render target for headless and benchmark runs,
+// frag_stats lands in a second RGBA32F attachment
+struct framebuffer_t {
+  GLuint fbo    { 0 };
+  GLuint color  { 0 };
+  GLuint stats  { 0 };
+  int    width  { 0 };
+  int    height { 0 };
+
+  void resize      (int, int);
+  void bind        (void);
+  void read        (uint8_t*); // bottom row first, like glReadPixels
+  void read_stats  (float*);   // 4 floats per pixel
+  ~framebuffer_t   (void);
+};
+
+#endif // _FRAMEBUFFER_H_
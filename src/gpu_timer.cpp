@@ -0,0 +1,96 @@
+#include "gpu_timer.hpp"
+
+gpu_timer_t::gpu_timer_t() {
+  enabled = GLEW_ARB_timer_query;
+  if (!enabled) {
+    SDL_Log("GL_ARB_timer_query is not supported, GPU pass times are disabled");
+    return;
+  }
+  glGenQueries(GPU_TIMER_LATENCY * GPU_PASS_COUNT * 2, &queries[0][0][0]);
+}
+
+gpu_timer_t::~gpu_timer_t() {
+  if (enabled) glDeleteQueries(GPU_TIMER_LATENCY * GPU_PASS_COUNT * 2, &queries[0][0][0]);
+}
+
+void gpu_timer_t::begin(gpu_pass_t pass) {
+  if (!enabled) return;
+  glQueryCounter(queries[frame % GPU_TIMER_LATENCY][pass][0], GL_TIMESTAMP);
+}
+
+void gpu_timer_t::end(gpu_pass_t pass) {
+  if (!enabled) return;
+  const int slot { frame % GPU_TIMER_LATENCY };
+  glQueryCounter(queries[slot][pass][1], GL_TIMESTAMP);
+  issued[slot][pass] = true;
+  frame_of[slot]     = frame;
+}
+
+void gpu_timer_t::end_frame() {
+  if (!enabled) return;
+  ++frame;
+  // this slot gets reused next, its queries are GPU_TIMER_LATENCY-1 frames old by now
+  collect(frame % GPU_TIMER_LATENCY, false);
+}
+
+void gpu_timer_t::flush() {
+  if (!enabled) return;
+  for (int i = 0; i < GPU_TIMER_LATENCY; ++i)
+    collect((frame + i) % GPU_TIMER_LATENCY, true); // oldest first
+}
+
+void gpu_timer_t::collect(int slot, bool wait) {
+  bool any_issued { false };
+  for (int pass = 0; pass < GPU_PASS_COUNT; ++pass) any_issued |= issued[slot][pass];
+  if (!any_issued) return;
+
+  if (!wait) {
+    for (int pass = 0; pass < GPU_PASS_COUNT; ++pass) {
+      if (!issued[slot][pass]) continue;
+      GLint available { 0 };
+      glGetQueryObjectiv(queries[slot][pass][1], GL_QUERY_RESULT_AVAILABLE, &available);
+      if (!available) { // the GPU is too far behind, skip the frame rather than stall
+        ++dropped;
+        for (int p = 0; p < GPU_PASS_COUNT; ++p) issued[slot][p] = false;
+        return;
+      }
+    }
+  }
+
+  latest.frame = frame_of[slot];
+  for (int pass = 0; pass < GPU_PASS_COUNT; ++pass) {
+    float ms { -1.0f };
+    if (issued[slot][pass]) {
+      GLuint64 start, end;
+      glGetQueryObjectui64v(queries[slot][pass][0], GL_QUERY_RESULT, &start);
+      glGetQueryObjectui64v(queries[slot][pass][1], GL_QUERY_RESULT, &end);
+      ms = static_cast<float>(static_cast<double>(end - start) / 1e6);
+      issued[slot][pass] = false;
+    }
+    latest.ms[pass]                = ms;
+    history[pass][history_head]    = glm::max(ms, 0.0f);
+  }
+  history_head = (history_head + 1) % GPU_TIMER_HISTORY;
+}
+
+void gpu_timer_t::draw_ui() {
+  if (!enabled) return;
+  if (!ImGui::CollapsingHeader("GPU passes", ImGuiTreeNodeFlags_DefaultOpen)) return;
+
+  float total { 0.0f };
+  for (int pass = 0; pass < GPU_PASS_COUNT; ++pass) {
+    float peak { 0.0f };
+    for (float ms : history[pass]) peak = glm::max(peak, ms);
+
+    // newest sample is the one before history_head
+    const float last { history[pass][(history_head + GPU_TIMER_HISTORY - 1) % GPU_TIMER_HISTORY] };
+    total += last;
+
+    char overlay[64];
+    snprintf(overlay, sizeof(overlay), "%.3f ms (peak %.3f)", last, peak);
+    ImGui::PlotLines(gpu_pass_names[pass], history[pass], GPU_TIMER_HISTORY, history_head,
+                     overlay, 0.0f, glm::max(peak * 1.2f, 0.1f), ImVec2(0, 48));
+  }
+  ImGui::Text("GPU total %.3f ms, %d frames late, %llu dropped", total, GPU_TIMER_LATENCY - 1,
+              static_cast<unsigned long long>(dropped));
+}
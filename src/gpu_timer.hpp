@@ -0,0 +1,54 @@
+#ifndef _GPU_TIMER_H_
+#define _GPU_TIMER_H_
+
+#include "main.hpp"
+#include "imgui.h"
+
+// frames of queries in flight, results are read GPU_TIMER_LATENCY-1 frames later so they never stall
+#define GPU_TIMER_LATENCY 4
+// samples per pass kept for the graph
+#define GPU_TIMER_HISTORY 240
+
+enum gpu_pass_t {
+  GPU_PASS_RAY_MARCH = 0,
+  GPU_PASS_IMGUI,
+  GPU_PASS_COUNT
+};
+
+constexpr const char* gpu_pass_names[GPU_PASS_COUNT] {
+  "ray march",
+  "imgui",
+};
+
+// GPU time of one frame's passes in ms, negative when the pass didn't run
+struct gpu_sample_t {
+  int   frame { -1 };
+  float ms[GPU_PASS_COUNT] {};
+};
+
+// GL_TIMESTAMP queries around each pass, a pair per pass per frame in flight
+struct gpu_timer_t {
+  bool         enabled  { false };
+  GLuint       queries[GPU_TIMER_LATENCY][GPU_PASS_COUNT][2] {};
+  bool         issued[GPU_TIMER_LATENCY][GPU_PASS_COUNT]     {};
+  int          frame_of[GPU_TIMER_LATENCY]                   {};
+  int          frame    { 0 };
+  uint64_t     dropped  { 0 }; // frames whose results weren't ready in time
+
+  float        history[GPU_PASS_COUNT][GPU_TIMER_HISTORY] {};
+  int          history_head { 0 };
+  gpu_sample_t latest   {};
+
+  gpu_timer_t  (void);
+  ~gpu_timer_t (void);
+
+  void begin     (gpu_pass_t);
+  void end       (gpu_pass_t);
+  void end_frame (void);
+  void flush     (void); // waits for every frame in flight, for benchmarks
+  void draw_ui   (void);
+
+  void collect   (int, bool);
+};
+
+#endif // _GPU_TIMER_H_
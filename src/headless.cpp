@@ -0,0 +1,82 @@
+#include "headless.hpp"
+
+#ifdef SDF_HEADLESS_EGL
+
+#define EGL_FAIL(what)                                                           \
+  do {                                                                           \
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "%s:%d: %s failed: 0x%x",         \
+                 __FILE__, __LINE__, (what), eglGetError());                     \
+    return false;                                                                \
+  } while (0)
+
+static bool has_extension(const char* extensions, const char* name) {
+  if (!extensions) return false;
+  const size_t len { strlen(name) };
+  for (const char* s = strstr(extensions, name); s; s = strstr(s + len, name))
+    if ((s == extensions || s[-1] == ' ') && (s[len] == ' ' || s[len] == '\0'))
+      return true;
+  return false;
+}
+
+bool headless_context_t::init() {
+  // prefer the surfaceless platform so nothing tries to reach an X or wayland server
+  const char* client_extensions { eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS) };
+  if (has_extension(client_extensions, "EGL_MESA_platform_surfaceless")) {
+    auto get_platform_display {
+      reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(eglGetProcAddress("eglGetPlatformDisplayEXT")) };
+    if (get_platform_display)
+      display = get_platform_display(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+  }
+  if (display == EGL_NO_DISPLAY)
+    display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+  if (display == EGL_NO_DISPLAY) EGL_FAIL("eglGetDisplay");
+
+  EGLint major, minor;
+  if (!eglInitialize(display, &major, &minor)) EGL_FAIL("eglInitialize");
+
+  const char* extensions { eglQueryString(display, EGL_EXTENSIONS) };
+  if (!has_extension(extensions, "EGL_KHR_surfaceless_context")) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "EGL_KHR_surfaceless_context is not supported");
+    return false;
+  }
+
+  if (!eglBindAPI(EGL_OPENGL_API)) EGL_FAIL("eglBindAPI");
+
+  // we never create a surface so any config will do
+  EGLConfig config { EGL_NO_CONFIG_KHR };
+  if (!has_extension(extensions, "EGL_KHR_no_config_context")) {
+    const EGLint config_attribs[] {
+      EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+      EGL_SURFACE_TYPE,    EGL_PBUFFER_BIT,
+      EGL_NONE
+    };
+    EGLint num_configs { 0 };
+    if (!eglChooseConfig(display, config_attribs, &config, 1, &num_configs) || num_configs == 0)
+      EGL_FAIL("eglChooseConfig");
+  }
+
+  const EGLint context_attribs[] {
+    EGL_CONTEXT_MAJOR_VERSION,       3,
+    EGL_CONTEXT_MINOR_VERSION,       3,
+    EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+    EGL_NONE
+  };
+  context = eglCreateContext(display, config, EGL_NO_CONTEXT, context_attribs);
+  if (context == EGL_NO_CONTEXT) EGL_FAIL("eglCreateContext");
+
+  if (!eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context)) EGL_FAIL("eglMakeCurrent");
+
+  SDL_Log("EGL %d.%d: %s, %s", major, minor, glGetString(GL_RENDERER), glGetString(GL_VERSION));
+  return true;
+}
+
+headless_context_t::~headless_context_t() {
+  if (display == EGL_NO_DISPLAY) return;
+  eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+  if (context != EGL_NO_CONTEXT) eglDestroyContext(display, context);
+  eglTerminate(display);
+}
+
+#undef EGL_FAIL
+
+#endif // SDF_HEADLESS_EGL
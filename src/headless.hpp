@@ -0,0 +1,21 @@
+#ifndef _HEADLESS_H_
+#define _HEADLESS_H_
+
+#include "main.hpp"
+
+#ifdef SDF_HEADLESS_EGL
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+// GL 3.3 core context with no window or surface behind it. Render into a
+// framebuffer_t. With mesa this also runs on llvmpipe on machines without a GPU.
+struct headless_context_t {
+  EGLDisplay display { EGL_NO_DISPLAY };
+  EGLContext context { EGL_NO_CONTEXT };
+
+  bool init             (void);
+  ~headless_context_t   (void);
+};
+#endif // SDF_HEADLESS_EGL
+
+#endif // _HEADLESS_H_
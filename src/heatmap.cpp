@@ -0,0 +1,58 @@
+#include "heatmap.hpp"
+
+void heatmap_stats_t::build(const float* stats, int count, float max_value) {
+  pixels    = count;
+  bin_width = glm::max(max_value, 1.0f) / HEATMAP_BINS;
+  for (int c = 0; c < HEATMAP_COUNT - 1; ++c) {
+    totals[c] = 0;
+    peak[c]   = 0.0f;
+    for (float& bin : histogram[c]) bin = 0.0f;
+  }
+
+  for (int i = 0; i < count; ++i) {
+    for (int c = 0; c < HEATMAP_COUNT - 1; ++c) {
+      const float v { stats[i * 4 + c] };
+      totals[c] += static_cast<uint64_t>(v);
+      peak[c]    = glm::max(peak[c], v);
+      histogram[c][glm::min(static_cast<int>(v / bin_width), HEATMAP_BINS - 1)] += 1.0f;
+    }
+  }
+}
+
+void heatmap_stats_t::draw_ui(int mode) {
+  if (!ImGui::CollapsingHeader("Pixel stats", ImGuiTreeNodeFlags_DefaultOpen)) return;
+  if (pixels == 0) return;
+
+  const int c { mode > HEATMAP_OFF ? mode - 1 : 0 };
+  float tallest { 0.0f };
+  for (float bin : histogram[c]) tallest = glm::max(tallest, bin);
+
+  char overlay[64];
+  snprintf(overlay, sizeof(overlay), "0 .. %.0f, %.1f per bin", bin_width * HEATMAP_BINS, bin_width);
+  ImGui::PlotHistogram(heatmap_names[c + 1], histogram[c], HEATMAP_BINS, 0, overlay,
+                       0.0f, tallest, ImVec2(0, 64));
+
+  for (int i = 0; i < HEATMAP_COUNT - 1; ++i)
+    ImGui::Text("%-12s total %10llu  mean %7.2f  peak %6.0f", heatmap_names[i + 1],
+                static_cast<unsigned long long>(totals[i]),
+                static_cast<double>(totals[i]) / pixels, peak[i]);
+}
+
+void heatmap_stats_t::print(FILE* f) const {
+  for (int c = 0; c < HEATMAP_COUNT - 1; ++c) {
+    fprintf(f, "%-12s total %llu, mean %.2f, peak %.0f\n", heatmap_names[c + 1],
+            static_cast<unsigned long long>(totals[c]),
+            pixels ? static_cast<double>(totals[c]) / pixels : 0.0, peak[c]);
+
+    // coarse text histogram, HEATMAP_BINS / 8 rows
+    for (int row = 0; row < HEATMAP_BINS / 8; ++row) {
+      float n { 0.0f };
+      for (int b = row * 8; b < row * 8 + 8; ++b) n += histogram[c][b];
+      const int bar { pixels ? static_cast<int>(n / pixels * 50.0f + 0.5f) : 0 };
+      char range[32];
+      if (row == HEATMAP_BINS / 8 - 1) snprintf(range, sizeof(range), "%.0f+", row * 8 * bin_width);
+      else snprintf(range, sizeof(range), "%.0f..%.0f", row * 8 * bin_width, (row + 1) * 8 * bin_width);
+      fprintf(f, "  %-14s %7.0f %.*s\n", range, n, bar, "##################################################");
+    }
+  }
+}
@@ -0,0 +1,33 @@
+#ifndef _HEATMAP_H_
+#define _HEATMAP_H_
+
+#include "main.hpp"
+#include "imgui.h"
+
+// the last bin also takes every count past heatmap_max
+#define HEATMAP_BINS 64
+
+constexpr const char* heatmap_names[HEATMAP_COUNT] {
+  "off",
+  "march steps",
+  "shadow steps",
+  "sdf calls",
+  "brick steps",
+};
+
+// totals and distribution of the per pixel counters of one frame, read from the
+// RGBA32F stats of framebuffer_t or cpu_framebuffer_t (x march, y shadow, z sdf calls,
+// w brick steps)
+struct heatmap_stats_t {
+  int      pixels { 0 };
+  uint64_t totals[HEATMAP_COUNT - 1]    {};
+  float    peak[HEATMAP_COUNT - 1]      {};
+  float    histogram[HEATMAP_COUNT - 1][HEATMAP_BINS] {};
+  float    bin_width { 0.0f };
+
+  void build   (const float*, int, float); // stats, pixel count, heatmap_max
+  void draw_ui (int); // histogram of the counter the overlay shows, march steps when it's off
+  void print   (FILE*) const;
+};
+
+#endif // _HEATMAP_H_
@@ -1,7 +1,7 @@
 #include <SDL2/SDL.h>
-#include <gl/glew.h>
+#include <GL/glew.h>
 #include <SDL2/SDL_opengl.h>
-#include <GL/GLU.h>
+#include <GL/glu.h>
 
 #include "imgui.h"
 #include "imgui_impl_sdl.h"
@@ -16,36 +16,656 @@
 
 #include "main.hpp"
 #include "util.cpp"
+#include "program_cache.cpp"
 #include "shader.cpp"
+#include "sdf.cpp"
+#include "scene.cpp"
+#include "tile_cull.cpp"
+#include "bvh.cpp"
+#include "scheduler.cpp"
+#include "mesh_sdf.cpp"
+#include "brick_map.cpp"
+#include "mesh_export.cpp"
+#include "cpu_renderer.cpp"
+#include "framebuffer.cpp"
+#include "readback.cpp"
+#include "camera_path.cpp"
+#include "headless.cpp"
+#include "benchmark.cpp"
+#include "gpu_timer.cpp"
+#include "heatmap.cpp"
 
+#include <chrono>
+#include <memory>
+#include <vector>
 
-int main (int argc, char** argv) {
-  (void) argc;
-  (void) argv;
+static void print_usage(const char* program) {
+  printf("usage: %s [options]\n"
+         "  --cpu            render one frame with the CPU backend and exit\n"
+         "  --cpu-bench      time the scalar and packet CPU paths over --frames frames\n"
+         "  --scalar         march one ray at a time instead of SIMD packets\n"
+         "  --no-prune       march CPU primary rays on the whole scene instead of per tile tapes\n"
+         "  --headless       render --frames frames with the GLSL path on a surfaceless EGL context\n"
+         "  --benchmark F    follow the camera path in F without vsync and print frame time\n"
+         "                   percentiles as json, add --cpu for the CPU backend or --headless for EGL\n"
+         "  --warmup N       frames rendered before measuring starts (default 10)\n"
+         "  --frames N       number of frames to render (default 10)\n"
+         "  --size WxH       resolution of the offscreen frame (default %dx%d)\n"
+         "  --camera-path F  camera/slider keys to follow, see camera_path.hpp\n"
+         "  --scene F        CSG scene to render instead of the built in one, see scene.hpp\n"
+         "  --no-fold        compile the scene as written, without folding its constant transforms\n"
+         "  --relax W        over-relaxed sphere tracing, steps are W (1 to 2) times the distance and\n"
+         "                   back off where that could skip a surface (default 1, plain steps)\n"
+         "  --prepass        cone march at 1/8 and then 1/4 of the resolution first, primary rays start\n"
+         "                   where the cone around their pixel stopped\n"
+         "  --footprint F    primary rays hit within F pixel footprints of a surface, the footprint\n"
+         "                   growing with the distance marched (default 0, surface distance only)\n"
+         "  --tape           interpret the scene in the shader instead of compiling it in, scene edits\n"
+         "                   are then a buffer upload rather than a shader rebuild\n"
+         "  --cull           bin the scene's objects into screen tiles so GLSL primary rays only evaluate\n"
+         "                   the ones whose bounds reach their tile, ignored with --tape\n"
+         "  --bvh            evaluate the scene through a bounding volume hierarchy over its objects,\n"
+         "                   skipping the ones that can't be closer than the best so far\n"
+         "  --bricks         bake the scene into a sparse brick map and march on its samples until\n"
+         "                   rays get close to a surface, the map is rebaked when the sliders move\n"
+         "  --segment        segment tracing: step by the distance over the scene's Lipschitz bound along\n"
+         "                   the segment ahead, safe where scales and blends stretch the distance\n"
+         "  --mesh F         extract the scene's surface to F (.ply, or .obj) on the CPU and exit\n"
+         "  --mesh-res N     cells along the longest side of the mesh grid (default 256)\n"
+         "  --dt SECONDS     time step between frames along the camera path (default 1/60)\n"
+         "  --threads N      CPU worker threads (default: one per core)\n"
+         "  --out PATH       where to write frames, %%d (or %%04d) is replaced by the frame number and\n"
+         "                   %%%% by a %%, a path without %%d takes a single frame (--cpu defaults to\n"
+         "                   frame.ppm, --headless writes nothing without it)\n"
+         "  --heatmap MODE   false colour per pixel counts instead of shading and print their histogram,\n"
+         "                   MODE is march, shadow, sdf or bricks\n"
+         "  --heatmap-max N  count at the red end of the heatmap (default 100)\n",
+         program, DEFAULT_WIDTH, DEFAULT_HEIGHT);
+}
+
+static options_t parse_options(int argc, char** argv) {
+  options_t opts {};
+  for (int i = 1; i < argc; ++i) {
+    const char* arg  { argv[i] };
+    const bool  more { i + 1 < argc };
+    if (strcmp(arg, "--cpu") == 0) {
+      opts.cpu = true;
+    } else if (strcmp(arg, "--cpu-bench") == 0) {
+      opts.bench = true;
+    } else if (strcmp(arg, "--scalar") == 0) {
+      opts.scalar = true;
+    } else if (strcmp(arg, "--no-prune") == 0) {
+      opts.prune = false;
+    } else if (strcmp(arg, "--frames") == 0 && more) {
+      opts.frames = glm::max(1, atoi(argv[++i]));
+    } else if (strcmp(arg, "--size") == 0 && more) {
+      if (sscanf(argv[++i], "%dx%d", &opts.width, &opts.height) != 2 || opts.width <= 0 || opts.height <= 0) {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Invalid size `%s`, expected WxH", argv[i]);
+        exit(1);
+      }
+    } else if (strcmp(arg, "--threads") == 0 && more) {
+      opts.threads = atoi(argv[++i]);
+    } else if (strcmp(arg, "--out") == 0 && more) {
+      opts.out_path = argv[++i];
+    } else if (strcmp(arg, "--headless") == 0) {
+      opts.headless = true;
+    } else if (strcmp(arg, "--camera-path") == 0 && more) {
+      opts.path = argv[++i];
+    } else if (strcmp(arg, "--scene") == 0 && more) {
+      opts.scene = argv[++i];
+    } else if (strcmp(arg, "--no-fold") == 0) {
+      opts.fold = false;
+    } else if (strcmp(arg, "--relax") == 0 && more) {
+      opts.relax = glm::clamp(static_cast<float>(atof(argv[++i])), 1.0f, 2.0f);
+    } else if (strcmp(arg, "--prepass") == 0) {
+      opts.prepass = true;
+    } else if (strcmp(arg, "--footprint") == 0 && more) {
+      opts.footprint = glm::max(static_cast<float>(atof(argv[++i])), 0.0f);
+    } else if (strcmp(arg, "--tape") == 0) {
+      opts.tape = true;
+    } else if (strcmp(arg, "--cull") == 0) {
+      opts.cull = true;
+    } else if (strcmp(arg, "--bvh") == 0) {
+      opts.bvh = true;
+    } else if (strcmp(arg, "--bricks") == 0) {
+      opts.bricks = true;
+    } else if (strcmp(arg, "--segment") == 0) {
+      opts.segment = true;
+    } else if (strcmp(arg, "--mesh") == 0 && more) {
+      opts.mesh = argv[++i];
+    } else if (strcmp(arg, "--mesh-res") == 0 && more) {
+      opts.mesh_res = glm::max(2 * MESH_PAD + 1, atoi(argv[++i]));
+    } else if (strcmp(arg, "--dt") == 0 && more) {
+      opts.dt = static_cast<float>(atof(argv[++i]));
+    } else if (strcmp(arg, "--benchmark") == 0 && more) {
+      opts.benchmark = true;
+      opts.path      = argv[++i];
+    } else if (strcmp(arg, "--warmup") == 0 && more) {
+      opts.warmup = glm::max(0, atoi(argv[++i]));
+    } else if (strcmp(arg, "--heatmap") == 0 && more) {
+      const char* modes[HEATMAP_COUNT] { "off", "march", "shadow", "sdf", "bricks" };
+      opts.heatmap = -1;
+      for (int m = 0; m < HEATMAP_COUNT; ++m)
+        if (strcmp(argv[i + 1], modes[m]) == 0) opts.heatmap = m;
+      if (opts.heatmap < 0) {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Unknown heatmap `%s`, expected march, shadow, sdf or bricks", argv[i + 1]);
+        exit(1);
+      }
+      ++i;
+    } else if (strcmp(arg, "--heatmap-max") == 0 && more) {
+      opts.heatmap_max = glm::max(1.0f, static_cast<float>(atof(argv[++i])));
+    } else {
+      print_usage(argv[0]);
+      exit(strcmp(arg, "--help") == 0 ? 0 : 1);
+    }
+  }
+  // the same rule for every mode that writes frames, a path without %d only takes one
+  if (opts.out_path) {
+    const int  numbers { frame_path_numbers(opts.out_path) };
+    const bool many    { opts.headless && !opts.benchmark && !opts.bench && !opts.mesh && !opts.cpu && opts.frames > 1 };
+    if (numbers < 0 || numbers > 1) {
+      SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                   "Invalid --out `%s`, expected at most one %%d (or %%04d) and %%%% for a literal %%", opts.out_path);
+      exit(1);
+    }
+    if (many && numbers == 0) {
+      SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "--out `%s` needs a %%d to write %d frames", opts.out_path, opts.frames);
+      exit(1);
+    }
+  }
+  return opts;
+}
+
+static bool load_scene(const options_t& opts, scene_t& scene) {
+  scene.fold = opts.fold;
+  return opts.scene ? scene.load(opts.scene) : scene.parse(default_scene_src, "built in scene");
+}
+
+// how the GLSL path gets the scene: generated code, the tape interpreter, or the objects
+// generated one by one for tile culling and the bvh. the tape takes precedence over those,
+// unless the scene is longer than the interpreter holds and gets the generated code instead.
+// the brick map works with any of them, it's baked on the CPU through the bvh
+struct gl_scene_t {
+  bool               use_tape   { false };
+  bool               use_cull   { false };
+  bool               use_bvh    { false };
+  bool               use_bricks { false };
+  bool               use_segment{ false };
+  bool               tape_fits  { true  }; // the loaded scene's tape is at most SCENE_MAX_TAPE long
+  std::vector<float> tape;
+  tile_cull_t        cull;
+  scene_bvh_t        bvh;
+  brick_map_t        bricks;
+  vec4               baked_slider { NAN }; // NAN after init, so the next upload bakes
+  bool               meshes_sent  { false }; // the scene's mesh atlas, sent by the first upload after init
+  vec4               rotated_slider { NAN };   // the sliders u_rotate was computed for
+  std::vector<float> rotations;
+  std::unique_ptr<scheduler_t> baker; // started by the first bake
+
+  gl_scene_t  (const options_t& opts)
+    : use_tape(opts.tape), use_cull(opts.cull), use_bvh(opts.bvh), use_bricks(opts.bricks), use_segment(opts.segment) {}
+  bool        taped   (void) const { return use_tape && tape_fits; }
+  bool        objects (void) const { return !taped() && (use_cull || use_bvh); }
+  void        init    (const scene_t&); // after every load
+  std::string glsl    (const scene_t&) const; // what shader_t splices into fragment.glsl
+  void        upload  (shader_t&, scene_t&, const float [4], int, int, const camera_t&, const ray_march_params_t&); // once a frame
+};
+
+void gl_scene_t::init(const scene_t& scene) {
+  cull.init(scene);
+  bvh.init(scene);
+  baked_slider   = vec4(NAN);
+  meshes_sent    = false;
+  rotated_slider = vec4(NAN);
+  tape_fits      = scene.tape.size() <= SCENE_MAX_TAPE;
+  if (use_tape && !tape_fits)
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Scene tape has %zu instructions, the interpreter holds %d, "
+                 "compiling the scene instead", scene.tape.size(), SCENE_MAX_TAPE);
+}
+
+std::string gl_scene_t::glsl(const scene_t& scene) const {
+  std::string src { use_bricks ? bricks.glsl() : std::string() };
+  if (use_segment) src += scene_segment_glsl();
+  if (taped())     return src + scene_tape_glsl(); // the same for every scene, sdf_graph_bound too
+  if (use_segment) src += scene.glsl_bound();
+  if (!objects())  return src + scene.glsl();
+  src += scene.glsl() + objects_glsl(scene, cull.objects, use_bvh); // the bvh's normals take the nearest object's gradient
+  if (use_cull) src += cull.glsl();
+  if (use_bvh)  src += bvh.glsl();
+  return src;
+}
+
+// the sliders are folded into the tape and the bounds, the tiles move with the camera too
+void gl_scene_t::upload(shader_t& shader, scene_t& scene, const float slider_values[4],
+                        int width, int height, const camera_t& camera, const ray_march_params_t& params) {
+  const vec4 slider { slider_values[0], slider_values[1], slider_values[2], slider_values[3] };
+  if (!meshes_sent) {
+    shader.set_meshes(scene);
+    meshes_sent = true;
+  }
+  if (slider != rotated_slider) {
+    scene.bind_rotations(slider, rotations);
+    shader.set_rotations(rotations);
+    rotated_slider = slider;
+  }
+  if (use_bricks && slider != baked_slider) {
+    if (!baker) baker = std::make_unique<scheduler_t>();
+    scene.bind(slider);
+    bvh.build(scene);
+    bricks.bake(bvh, *baker);
+    shader.set_bricks(bricks);
+    baked_slider = slider;
+  }
+  if (taped()) {
+    scene.pack_tape(slider, tape);
+    shader.set_tape(tape);
+    return;
+  }
+  if (!objects()) return;
+  scene.bind(slider);
+  if (use_cull) {
+    cull.build(scene, width, height, camera, params);
+    shader.set_tile_lists(cull.lists, cull.tiles_x);
+  }
+  if (use_bvh) {
+    bvh.build(scene);
+    shader.set_bvh(bvh.texels);
+  }
+}
+
+// headless path, needs neither a window nor a GL context
+static int run_cpu(const options_t& opts) {
+  scene_t scene {};
+  if (!load_scene(opts, scene)) return 1;
+
+  cpu_renderer_t     renderer  { opts.threads };
+  cpu_framebuffer_t  fb        {};
+  camera_t           camera    {};
+  ray_march_params_t rm_params {};
+  float              slider_values[4] { 0.5f, 0.5f, 0.5f, 0.5f };
+
+  fb.resize(opts.width, opts.height, CPU_FORMAT_RGBA8);
+  renderer.packets      = !opts.scalar;
+  renderer.prune        = opts.prune;
+  renderer.bvh          = opts.bvh;
+  renderer.bricks       = opts.bricks;
+  renderer.segment      = opts.segment;
+  rm_params.heatmap     = opts.heatmap;
+  rm_params.heatmap_max = opts.heatmap_max;
+  rm_params.relaxation  = opts.relax;
+  rm_params.prepass     = opts.prepass;
+  rm_params.footprint   = opts.footprint;
+
+  const auto start { std::chrono::steady_clock::now() };
+  renderer.run(fb, scene, rm_params, slider_values, camera);
+  const auto end   { std::chrono::steady_clock::now() };
+
+  const double ms { std::chrono::duration<double, std::milli>(end - start).count() };
+  printf("cpu: %dx%d on %d threads (%s) in %.2f ms (%.2f Mrays/s)\n",
+         fb.width, fb.height, renderer.scheduler.num_workers(),
+         renderer.packets ? SIMD_NAME : "scalar", ms,
+         static_cast<double>(fb.width) * fb.height / (ms * 1000.0));
+  const char* ran_on[4] { "", " on their tile's tapes", " through the bvh", " on their tile's tapes or the bvh" };
+  printf("tape: %zu instructions (%d as written), primary rays ran %.1f per step%s\n", scene.tape.size(), scene.unfolded,
+         static_cast<double>(renderer.march_instructions) / glm::max<double>(1.0, renderer.march_steps),
+         ran_on[opts.prune + 2 * opts.bvh]);
+  const double pixels { static_cast<double>(fb.width) * fb.height };
+  printf("march: %.1f steps per pixel, %.1f shadow steps, relaxation %.2f\n",
+         static_cast<double>(renderer.march_steps) / pixels, static_cast<double>(renderer.shadow_steps) / pixels,
+         static_cast<double>(rm_params.relaxation));
+  if (opts.prepass)
+    printf("prepass: %.2f cone steps per pixel, at 1/%d and 1/%d of the resolution\n",
+           static_cast<double>(renderer.prepass_steps) / pixels, PREPASS_COARSE, PREPASS_FINE);
+  if (opts.segment) // a ball that holds everything, every branch counts
+    printf("segment: Lipschitz bound %.3f over the whole scene\n",
+           static_cast<double>(renderer.bound_scene.eval_bound(vec3(0.0f), 1e10f).z));
+  if (opts.bricks) {
+    const uint64_t steps { renderer.march_steps + renderer.shadow_steps };
+    printf("bricks: %d baked in %.2f ms, %.1f%% of %llu steps taken on the map, %.1f sdf calls per pixel\n",
+           renderer.brick_map.bricks, renderer.brick_map.bake_ms,
+           100.0 * static_cast<double>(renderer.brick_steps) / glm::max<double>(1.0, steps),
+           static_cast<unsigned long long>(steps),
+           static_cast<double>(renderer.sdf_calls) / pixels);
+  }
+
+  if (opts.heatmap != HEATMAP_OFF) {
+    heatmap_stats_t stats {};
+    stats.build(fb.stats, fb.width * fb.height, opts.heatmap_max);
+    stats.print(stdout);
+  }
+
+  char file_path[512];
+  frame_path(file_path, sizeof(file_path), opts.out_path ? opts.out_path : "frame.ppm", 0);
+  return write_ppm(file_path, fb.width, fb.height, static_cast<uint8_t*>(fb.pixels)) ? 0 : 1;
+}
+
+// the scene at the default slider values, like --cpu renders it
+static int run_mesh(const options_t& opts) {
+  scene_t scene {};
+  if (!load_scene(opts, scene)) return 1;
+  scene.bind(vec4(0.5f));
+
+  scene_bvh_t   bvh       {};
+  scheduler_t   scheduler { opts.threads };
+  mesh_writer_t writer    {};
+  mesh_export_t mesher    {};
+  bvh.init(scene);
+  bvh.build(scene);
+  mesher.resolution = opts.mesh_res;
+
+  if (!writer.open(opts.mesh)) return 1;
+  const bool ran    { mesher.run(bvh, scheduler, writer) };
+  const bool closed { writer.close() };
+  if (!ran || !closed) return 1;
+
+  printf("mesh: %s, %llu vertices, %llu triangles, %dx%dx%d cells in %.2f ms on %d threads\n", opts.mesh,
+         static_cast<unsigned long long>(writer.vertices), static_cast<unsigned long long>(writer.triangles),
+         mesher.cells.x, mesher.cells.y, mesher.cells.z, mesher.ms, scheduler.num_workers());
+  printf("chunks: %d of %d skipped as empty, at most %zu seam vertices held\n", mesher.empty_chunks,
+         mesher.chunks.x * mesher.chunks.y * mesher.chunks.z, mesher.peak_seams);
+  if (mesher.dropped)
+    SDL_Log("%llu quads lost cells to skipped chunks, the scene's distance overestimates somewhere",
+            static_cast<unsigned long long>(mesher.dropped));
+  return 0;
+}
+
+// primary rays per second of the scalar and packet paths on the same frames
+static int run_cpu_bench(const options_t& opts) {
+  scene_t scene {};
+  if (!load_scene(opts, scene)) return 1;
+
+  cpu_renderer_t     renderer  { opts.threads };
+  cpu_framebuffer_t  fb        {};
+  camera_t           camera    {};
+  ray_march_params_t rm_params {};
+  float              slider_values[4] { 0.5f, 0.5f, 0.5f, 0.5f };
+
+  fb.resize(opts.width, opts.height, CPU_FORMAT_RGBA8);
+  renderer.prune  = opts.prune;
+  renderer.bvh    = opts.bvh;
+  renderer.bricks = opts.bricks;
+  renderer.segment = opts.segment;
+  rm_params.relaxation = opts.relax;
+  rm_params.prepass    = opts.prepass;
+  rm_params.footprint  = opts.footprint;
+
+  double mrays[2] {};
+  for (int mode = 0; mode < 2; ++mode) {
+    renderer.packets = (mode == 1);
+    renderer.run(fb, scene, rm_params, slider_values, camera); // warm up caches and threads
+
+    const auto start { std::chrono::steady_clock::now() };
+    for (int i = 0; i < opts.frames; ++i)
+      renderer.run(fb, scene, rm_params, slider_values, camera);
+    const auto end   { std::chrono::steady_clock::now() };
+
+    const double ms { std::chrono::duration<double, std::milli>(end - start).count() };
+    mrays[mode] = static_cast<double>(fb.width) * fb.height * opts.frames / (ms * 1000.0);
+    printf("%-8s %8.2f ms/frame %8.2f Mrays/s %8.1f tape instructions per march step\n",
+           renderer.packets ? SIMD_NAME : "scalar", ms / opts.frames, mrays[mode],
+           static_cast<double>(renderer.march_instructions) / glm::max<double>(1.0, renderer.march_steps));
+  }
+  printf("packet speedup %.2fx on %d threads, %dx%d\n",
+         mrays[1] / mrays[0], renderer.scheduler.num_workers(), fb.width, fb.height);
+  renderer.scheduler.print_stats(stdout); // last packet frame
+  return 0;
+}
+
+// glewInit also wants a GLX display, which a surfaceless context doesn't have
+static bool init_glew() {
+  glewExperimental = GL_TRUE;
+  const GLenum err { glewInit() };
+  if (err != GLEW_OK && err != GLEW_ERROR_NO_GLX_DISPLAY) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Could not initialize GLEW: %s", glewGetErrorString(err));
+    return false;
+  }
+  glGetError(); // glew leaves GL_INVALID_ENUM behind on core contexts
+  return true;
+}
+
+// runs the GLSL path into an offscreen framebuffer without SDL video
+static int run_headless(const options_t& opts) {
+#ifdef SDF_HEADLESS_EGL
+  headless_context_t context {};
+  if (!context.init() || !init_glew()) return 1;
+
+  camera_path_t path  {};
+  scene_t       scene {};
+  if (opts.path && !path.load(opts.path)) return 1;
+  if (!load_scene(opts, scene)) return 1;
+
+  gl_scene_t         gl_scene  { opts };
+  gl_scene.init(scene);
+  shader_t           shader    { gl_scene.glsl(scene) };
+  framebuffer_t      fb        {};
+  camera_t           camera    {};
+  ray_march_params_t rm_params {};
+  float              slider_values[4] { 0.5f, 0.5f, 0.5f, 0.5f };
+  int                size[2]   { opts.width, opts.height };
+
+  fb.resize(opts.width, opts.height);
+  rm_params.heatmap     = opts.heatmap;
+  rm_params.heatmap_max = opts.heatmap_max;
+  rm_params.relaxation  = opts.relax;
+  rm_params.prepass     = opts.prepass;
+  rm_params.footprint   = opts.footprint;
 
+  // frames are written on the readback thread while the next ones render
+  std::atomic<bool> write_failed { false };
+  readback_t        readback     { [&] (const readback_frame_t& frame) {
+    char file_path[512];
+    frame_path(file_path, sizeof(file_path), opts.out_path, frame.index);
+    if (!write_ppm(file_path, frame.width, frame.height, frame.pixels.data())) write_failed = true;
+  } };
+
+  const auto start { std::chrono::steady_clock::now() };
+  for (int i = 0; i < opts.frames && !write_failed; ++i) {
+    path.sample(i * opts.dt, camera, slider_values);
+    gl_scene.upload(shader, scene, slider_values, opts.width, opts.height, camera, rm_params);
+
+    fb.bind();
+    shader.run(size, rm_params, slider_values, camera);
+
+    if (opts.out_path) readback.capture(fb, i);
+  }
+  readback.flush();
+  glFinish();
+  const auto end   { std::chrono::steady_clock::now() };
+  if (write_failed) return 1;
+  if (readback.stalls)
+    SDL_Log("readback: waited on the GPU or the writer %llu times", static_cast<unsigned long long>(readback.stalls));
+
+  const double ms { std::chrono::duration<double, std::milli>(end - start).count() };
+  printf("headless: %d frames at %dx%d in %.2f ms (%.3f ms/frame, %.2f Mrays/s)\n",
+         opts.frames, fb.width, fb.height, ms, ms / opts.frames,
+         static_cast<double>(fb.width) * fb.height * opts.frames / (ms * 1000.0));
+
+  if (opts.heatmap != HEATMAP_OFF) { // of the last frame
+    std::vector<float> values(static_cast<size_t>(fb.width) * fb.height * 4);
+    fb.read_stats(values.data());
+    heatmap_stats_t stats {};
+    stats.build(values.data(), fb.width * fb.height, opts.heatmap_max);
+    stats.print(stdout);
+  }
+  return 0;
+#else
+  (void) opts;
+  SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "--headless needs a build with SDF_HEADLESS_EGL");
+  return 1;
+#endif
+}
+
+static SDL_Window* create_gl_window(Uint32 flags, SDL_GLContext* gl_context) {
   // init SDL to work with OpenGL
   check(SDL_Init(SDL_INIT_VIDEO));
 
   check(SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 3));
-  check(SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 1));
+  check(SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 3)); // timer queries, and fragment.glsl is #version 330
   check(SDL_GL_SetAttribute( SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_CORE ));
-  
+
   SDL_Window* window;
   checkp(window = SDL_CreateWindow("SDF in SDL",
                                    SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED,
                                    DEFAULT_WIDTH, DEFAULT_HEIGHT,
-                                   SDL_WINDOW_OPENGL | SDL_WINDOW_SHOWN));
-  
-  SDL_GLContext gl_context;
-  checkp(gl_context = SDL_GL_CreateContext(window));
+                                   SDL_WINDOW_OPENGL | flags));
 
-  int window_size[2] { DEFAULT_WIDTH, DEFAULT_HEIGHT };
+  checkp(*gl_context = SDL_GL_CreateContext(window));
+
+  if (!init_glew()) exit(1);
+  return window;
+}
+
+// fixed dt along the camera path so every run renders exactly the same frames,
+// only the measured frames count towards the results
+static int run_benchmark(const options_t& opts) {
+  camera_path_t path  {};
+  scene_t       scene {};
+  if (!path.load(opts.path) || !load_scene(opts, scene)) return 1;
+
+  benchmark_t        bench     {};
+  camera_t           camera    {};
+  ray_march_params_t rm_params {};
+  float              slider_values[4] { 0.5f, 0.5f, 0.5f, 0.5f };
+
+  bench.width  = opts.width;
+  bench.height = opts.height;
+  bench.warmup = opts.warmup;
+  bench.dt     = opts.dt;
+  bench.relaxation     = opts.relax;
+  bench.prepass        = opts.prepass;
+  bench.footprint      = opts.footprint;
+  rm_params.relaxation = opts.relax;
+  rm_params.prepass    = opts.prepass;
+  rm_params.footprint  = opts.footprint;
+
+  const int total_frames { opts.warmup + opts.frames };
+  auto frame_time = [&] (int i) {
+    return static_cast<float>(i < opts.warmup ? i : i - opts.warmup) * opts.dt;
+  };
+
+  if (opts.cpu) {
+    cpu_renderer_t    renderer { opts.threads };
+    cpu_framebuffer_t fb       {};
+    fb.resize(opts.width, opts.height, CPU_FORMAT_RGBA8);
+    renderer.packets = !opts.scalar;
+    renderer.prune   = opts.prune;
+    renderer.bvh     = opts.bvh;
+    renderer.bricks  = opts.bricks;
+    renderer.segment = opts.segment;
+
+    char device[64];
+    snprintf(device, sizeof(device), "%s x %d threads", renderer.packets ? SIMD_NAME : "scalar",
+             renderer.scheduler.num_workers());
+    bench.backend = opts.bricks ? "cpu-bricks" : "cpu";
+    if (opts.segment) bench.backend += "-segment";
+    if (!opts.prune)  bench.backend += "-no-prune";
+    bench.device  = device;
+
+    for (int i = 0; i < total_frames; ++i) {
+      path.sample(frame_time(i), camera, slider_values);
+
+      const auto start { std::chrono::steady_clock::now() };
+      renderer.run(fb, scene, rm_params, slider_values, camera);
+      const auto end   { std::chrono::steady_clock::now() };
+
+      if (i < opts.warmup) continue;
+      bench.frame_ms.push_back(std::chrono::duration<double, std::milli>(end - start).count());
+      bench.march_steps  += renderer.march_steps.load();
+      bench.shadow_steps += renderer.shadow_steps.load();
+      bench.sdf_calls    += renderer.sdf_calls.load();
+    }
+  } else {
+#ifdef SDF_HEADLESS_EGL
+    headless_context_t headless {};
+#endif
+    SDL_Window*   window     { nullptr };
+    SDL_GLContext gl_context { nullptr };
+    if (opts.headless) {
+#ifdef SDF_HEADLESS_EGL
+      if (!headless.init() || !init_glew()) return 1;
+#else
+      SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "--headless needs a build with SDF_HEADLESS_EGL");
+      return 1;
+#endif
+    } else {
+      window = create_gl_window(SDL_WINDOW_HIDDEN, &gl_context);
+      check(SDL_GL_SetSwapInterval(0)); // never wait for vsync
+    }
+
+    {
+      gl_scene_t    gl_scene { opts };
+      gl_scene.init(scene);
+      shader_t      shader  { gl_scene.glsl(scene) };
+      framebuffer_t fb      {};
+      gpu_timer_t   timer   {};
+      int           size[2] { opts.width, opts.height };
+      fb.resize(opts.width, opts.height);
+      std::vector<float> stats(static_cast<size_t>(opts.width) * opts.height * 4);
 
-  if (glewInit() != GLEW_OK) {
-    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Could not initialize GLEW");
-    return 1;
+      const char* backends[4] { "gl", "gl-cull", "gl-bvh", "gl-cull-bvh" };
+      bench.backend = opts.tape ? "gl-tape" : backends[opts.cull + 2 * opts.bvh];
+      if (opts.bricks) bench.backend += "-bricks";
+      if (opts.segment) bench.backend += "-segment";
+      bench.device  = reinterpret_cast<const char*>(glGetString(GL_RENDERER));
+
+      for (int i = 0; i < total_frames; ++i) {
+        path.sample(frame_time(i), camera, slider_values);
+
+        fb.bind();
+        glFinish(); // don't bill this frame for the previous one
+        const auto start { std::chrono::steady_clock::now() };
+        // uploads, binning, bvh builds and bakes are per frame work of their modes, so they're billed too
+        gl_scene.upload(shader, scene, slider_values, opts.width, opts.height, camera, rm_params);
+        timer.begin(GPU_PASS_RAY_MARCH);
+        shader.run(size, rm_params, slider_values, camera);
+        timer.end(GPU_PASS_RAY_MARCH);
+        glFinish();
+        const auto end   { std::chrono::steady_clock::now() };
+        timer.end_frame();
+        timer.flush();
+
+        if (i < opts.warmup) continue;
+        bench.frame_ms.push_back(std::chrono::duration<double, std::milli>(end - start).count());
+        if (timer.enabled && timer.latest.frame == i)
+          bench.gpu_ms.push_back(timer.latest.ms[GPU_PASS_RAY_MARCH]);
+
+        // outside the timed region
+        fb.read_stats(stats.data());
+        for (size_t p = 0; p < stats.size(); p += 4) {
+          bench.march_steps  += static_cast<uint64_t>(stats[p]);
+          bench.shadow_steps += static_cast<uint64_t>(stats[p + 1]);
+          bench.sdf_calls    += static_cast<uint64_t>(stats[p + 2]);
+        }
+      }
+    }
+
+    if (window) {
+      SDL_GL_DeleteContext(gl_context);
+      SDL_DestroyWindow(window);
+      SDL_Quit();
+    }
   }
 
+  bench.print_json(stdout);
+  return 0;
+}
+
+int main (int argc, char** argv) {
+  const options_t opts { parse_options(argc, argv) };
+  if (opts.benchmark) return run_benchmark(opts);
+  if (opts.bench)     return run_cpu_bench(opts);
+  if (opts.mesh)      return run_mesh(opts);
+  if (opts.cpu)       return run_cpu(opts);
+  if (opts.headless)  return run_headless(opts);
+
+  scene_t scene {};
+  if (!load_scene(opts, scene)) return 1;
+
+  SDL_GLContext gl_context;
+  SDL_Window*   window { create_gl_window(SDL_WINDOW_SHOWN, &gl_context) };
+
+  int window_size[2] { DEFAULT_WIDTH, DEFAULT_HEIGHT };
+
   check(SDL_GL_SetSwapInterval(1)); // enable vsync
 
   // set up ImGui
@@ -57,15 +677,40 @@ int main (int argc, char** argv) {
   ImGui_ImplSDL2_InitForOpenGL(window, gl_context);
   ImGui_ImplOpenGL3_Init("#version 330");
   
+  // hot reloads compile on a second context so the window keeps drawing with the old program
+  check(SDL_GL_SetAttribute(SDL_GL_SHARE_WITH_CURRENT_CONTEXT, 1));
+  SDL_GLContext compile_context { SDL_GL_CreateContext(window) };
+  check(SDL_GL_MakeCurrent(window, gl_context));
+
   // program state
-  shader_t           shader    {};
+  gl_scene_t         gl_scene  { opts };
+  gl_scene.init(scene);
+  shader_t           shader    { gl_scene.glsl(scene) };
+  gpu_timer_t        gpu_timer {};
   camera_t           camera    {};
   ray_march_params_t rm_params {};
+  rm_params.relaxation = opts.relax;
+  rm_params.prepass    = opts.prepass;
+  rm_params.footprint  = opts.footprint;
   
+  // pixel stats need the float attachment, so the frame goes through an FBO while they're shown
+  framebuffer_t      stats_fb    {};
+  heatmap_stats_t    pixel_stats {};
+  std::vector<float> stats_values;
+  bool               show_stats  { false };
+
   uint64_t shader_last_modified { get_last_modified_time(fragment_path) };
+  uint64_t scene_last_modified  { opts.scene ? get_last_modified_time(opts.scene) : 0 };
   float    mouse_sensitivity    { 0.001f };
   float    slider_values[4]     { 0.5f, 0.5f, 0.5f, 0.5f };
 
+  if (compile_context)
+    shader.start_worker([window, compile_context] (bool bind) {
+      return SDL_GL_MakeCurrent(window, bind ? compile_context : NULL) == 0;
+    });
+  else
+    SDL_Log("No shared GL context (%s), shaders are rebuilt on the main thread", SDL_GetError());
+
   bool should_quit { false };
   bool fullscreen  { false };
   uint64_t now     { SDL_GetPerformanceCounter() };
@@ -168,6 +813,15 @@ int main (int argc, char** argv) {
         shader.recompile();
         shader_last_modified = file_modified;
       }
+      // a scene that doesn't parse keeps the current one
+      if (opts.scene && scene_last_modified != get_last_modified_time(opts.scene)) {
+        scene_last_modified = get_last_modified_time(opts.scene);
+        if (scene.load(opts.scene)) {
+          gl_scene.init(scene);
+          shader.set_scene(gl_scene.glsl(scene));
+        }
+      }
+      shader.poll();
       
       // calculate camera position
       using namespace glm;
@@ -189,10 +843,45 @@ int main (int argc, char** argv) {
       ImGui::SliderInt("max steps", &rm_params.max_steps, 1, 10000);
       ImGui::SliderFloat("max distance", &rm_params.max_dist, 1.0f, 10000.0f);
       ImGui::SliderFloat("surface distance", &rm_params.surf_dist, 0.01f, 1.0f);
+      ImGui::SliderFloat("over-relaxation", &rm_params.relaxation, 1.0f, 2.0f);
+      ImGui::SliderInt("shadow steps", &rm_params.shadow_steps, 1, 10000);
+      ImGui::SliderFloat("penumbra", &rm_params.penumbra, 1.0f, 128.0f);
+      ImGui::Checkbox("cone prepass", &rm_params.prepass);
+      ImGui::SliderFloat("pixel footprint", &rm_params.footprint, 0.0f, 4.0f);
       ImGui::SliderFloat("mouse sensitivity", &mouse_sensitivity, 0.0001f, .005f);
       ImGui::SliderFloat4("sliders", slider_values, -10.0f, 10.0f);
+
+      // switching builds the other program in the background like any other reload
+      ImGui::Text("scene: %zu instructions, %d as written", scene.tape.size(), scene.unfolded);
+      if (ImGui::Checkbox("tape interpreter", &gl_scene.use_tape)) shader.set_scene(gl_scene.glsl(scene));
+      if (gl_scene.use_tape && !gl_scene.tape_fits)
+        ImGui::Text("tape: %zu instructions, more than the %d it holds, compiled instead", scene.tape.size(), SCENE_MAX_TAPE);
+      else if (gl_scene.use_tape)
+        ImGui::Text("tape: %d instructions, %d registers, last upload %.1f us",
+                    shader.tape_length, glm::max(scene.num_regs, scene.num_points), shader.tape_upload_us);
+      if (ImGui::Checkbox("tile culling", &gl_scene.use_cull)) shader.set_scene(gl_scene.glsl(scene));
+      const tile_cull_t& cull { gl_scene.cull };
+      if (gl_scene.objects() && gl_scene.use_cull && cull.tiles_x > 0)
+        ImGui::Text("culling: %zu objects, %.1f per tile on average", cull.objects.size(),
+                    static_cast<double>(cull.entries) / (cull.tiles_x * cull.tiles_y));
+      if (ImGui::Checkbox("bvh", &gl_scene.use_bvh)) shader.set_scene(gl_scene.glsl(scene));
+      if (gl_scene.objects() && gl_scene.use_bvh)
+        ImGui::Text("bvh: %zu objects, %zu nodes", gl_scene.bvh.objects.size(), gl_scene.bvh.nodes.size());
+      if (ImGui::Checkbox("brick map", &gl_scene.use_bricks)) {
+        gl_scene.baked_slider = vec4(NAN);
+        shader.set_scene(gl_scene.glsl(scene));
+      }
+      if (gl_scene.use_bricks)
+        ImGui::Text("bricks: %d, last bake %.1f ms", gl_scene.bricks.bricks, gl_scene.bricks.bake_ms);
+      if (ImGui::Checkbox("segment tracing", &gl_scene.use_segment)) shader.set_scene(gl_scene.glsl(scene));
+
+      ImGui::Combo("heatmap", &rm_params.heatmap, heatmap_names, HEATMAP_COUNT);
+      ImGui::SliderFloat("heatmap max", &rm_params.heatmap_max, 1.0f, 1000.0f);
+      ImGui::Checkbox("pixel stats (reads the frame back)", &show_stats);
+      if (show_stats) pixel_stats.draw_ui(rm_params.heatmap);
       
       ImGui::Text("Application average %.3f ms/frame (%.1f FPS)", 1000.0f / ImGui::GetIO().Framerate, ImGui::GetIO().Framerate);
+      gpu_timer.draw_ui();
       ImGui::End();
       ImGui::Render();
     }
@@ -202,9 +891,34 @@ int main (int argc, char** argv) {
     glClear(GL_COLOR_BUFFER_BIT);
     glViewport(0, 0, window_size[0], window_size[1]);
     
+    if (show_stats) {
+      stats_fb.resize(window_size[0], window_size[1]);
+      stats_fb.bind();
+    }
+
+    gl_scene.upload(shader, scene, slider_values, window_size[0], window_size[1], camera, rm_params);
+    gpu_timer.begin(GPU_PASS_RAY_MARCH);
     shader.run(window_size, rm_params, slider_values, camera);
+    gpu_timer.end(GPU_PASS_RAY_MARCH);
 
+    if (show_stats) {
+      glBindFramebuffer(GL_READ_FRAMEBUFFER, stats_fb.fbo);
+      glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+      glBlitFramebuffer(0, 0, window_size[0], window_size[1], 0, 0, window_size[0], window_size[1],
+                        GL_COLOR_BUFFER_BIT, GL_NEAREST);
+      glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+      // synchronous, it's a diagnostic view and the histogram is a frame behind the ui anyway
+      stats_values.resize(static_cast<size_t>(window_size[0]) * window_size[1] * 4);
+      stats_fb.read_stats(stats_values.data());
+      pixel_stats.build(stats_values.data(), window_size[0] * window_size[1], rm_params.heatmap_max);
+    }
+
+    gpu_timer.begin(GPU_PASS_IMGUI);
     ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+    gpu_timer.end(GPU_PASS_IMGUI);
+    gpu_timer.end_frame();
+
     SDL_GL_SwapWindow(window);
   }
   
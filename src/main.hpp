@@ -2,7 +2,7 @@
 #define _MAIN_H_
 
 #include <SDL2/SDL_opengl.h>
-#include <GL/GLU.h>
+#include <GL/glu.h>
 #include <glm/glm.hpp>
 
 #include "util.hpp"
@@ -14,10 +14,32 @@ using namespace glm;
 #define DEFAULT_WIDTH 800
 #define DEFAULT_HEIGHT 600
 
+// per pixel counters shown instead of the shaded colour, the stats attachment always has all of them
+enum heatmap_mode_t {
+  HEATMAP_OFF = 0,
+  HEATMAP_MARCH_STEPS,
+  HEATMAP_SHADOW_STEPS,
+  HEATMAP_SDF_CALLS,
+  HEATMAP_BRICK_STEPS,
+  HEATMAP_COUNT
+};
+
+// cone marched prepasses, each pixel of them covers this many full resolution ones a side.
+// the coarse one starts the fine one, which starts the primary rays of its pixels
+#define PREPASS_COARSE 8
+#define PREPASS_FINE   4
+
 struct ray_march_params_t {
-  int   max_steps { 500     };
-  float max_dist  { 5000.0f };
-  float surf_dist { 0.001f  };
+  int   max_steps    { 500         };
+  float max_dist     { 5000.0f     };
+  float surf_dist    { 0.001f      };
+  float relaxation   { 1.0f        }; // over-relaxed sphere tracing's step factor, 1 to 2, 1 is plain
+  int   shadow_steps { 256         }; // shadow rays stop at the light or after this many steps
+  float penumbra     { 8.0f        }; // soft shadow sharpness, larger is harder
+  bool  prepass      { false       }; // primary rays start where the cone prepasses stopped
+  float footprint    { 0.0f        }; // primary rays hit within this many pixels' width, t / height each
+  int   heatmap      { HEATMAP_OFF };
+  float heatmap_max  { 100.0f      }; // count mapped to the red end of the ramp
 };
 
 #define CAMERA_SPEED 12.5f
@@ -31,4 +53,36 @@ struct camera_t {
   bool  active   { false                  };
 };
 
+// command line, see print_usage in main.cpp
+struct options_t {
+  bool        cpu      { false          };
+  bool        bench    { false          };
+  bool        scalar   { false          };
+  bool        prune    { true           }; // per tile tapes for the CPU's primary rays
+  int         frames   { 10             };
+  int         width    { DEFAULT_WIDTH  };
+  int         height   { DEFAULT_HEIGHT };
+  int         threads  { 0              };
+  const char* out_path { nullptr        }; // frame_path pattern taking the frame number
+  bool        headless { false          };
+  const char* path     { nullptr        }; // camera path file
+  const char* scene    { nullptr        }; // scene file, the built in scene when null
+  bool        fold     { true           }; // scene_t::fold_constants before compiling the scene
+  float       relax    { 1.0f           }; // ray_march_params_t::relaxation
+  bool        prepass  { false          }; // ray_march_params_t::prepass
+  float       footprint{ 0.0f           }; // ray_march_params_t::footprint
+  bool        tape     { false          }; // GLSL path interprets the scene instead of compiling it
+  bool        cull     { false          }; // GLSL primary rays only see their tile's objects
+  bool        bvh      { false          }; // scene queries descend a bvh over its objects
+  bool        bricks   { false          }; // marchers step on a baked brick map far from surfaces
+  bool        segment  { false          }; // marchers step on local Lipschitz bounds, segment tracing
+  const char* mesh     { nullptr        }; // PLY or OBJ to export the scene to
+  int         mesh_res { 256            }; // cells along the longest side of the mesh grid
+  float       dt       { 1.0f / 60.0f   };
+  bool        benchmark{ false          }; // follows path, prints json
+  int         warmup   { 10             };
+  int         heatmap  { HEATMAP_OFF    };
+  float       heatmap_max { 100.0f   };
+};
+
 #endif // _MAIN_H_
@@ -0,0 +1,251 @@
+#include "mesh_export.hpp"
+
+#include <chrono>
+
+bool mesh_writer_t::open(const char* path) {
+  const char* ext { strrchr(path, '.') };
+  format = (ext && strcasecmp(ext, ".obj") == 0) ? MESH_OBJ : MESH_PLY;
+  vertices  = 0;
+  triangles = 0;
+
+  file = fopen(path, "wb");
+  if (file == NULL) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Could not open `%s` for writing", path);
+    return false;
+  }
+  if (format == MESH_PLY) {
+    faces = tmpfile();
+    if (faces == NULL) {
+      SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Could not create a temporary file for the faces of `%s`", path);
+      fclose(file);
+      file = nullptr;
+      return false;
+    }
+    header(); // written again with the counts by close, the padded counts keep its length
+  }
+  return true;
+}
+
+void mesh_writer_t::header() {
+  fprintf(file, "ply\nformat binary_little_endian 1.0\n"
+                "element vertex %010llu\nproperty float x\nproperty float y\nproperty float z\n"
+                "element face %010llu\nproperty list uchar uint vertex_indices\nend_header\n",
+          static_cast<unsigned long long>(vertices), static_cast<unsigned long long>(triangles));
+}
+
+void mesh_writer_t::vertex(vec3 v) {
+  ++vertices;
+  if (format == MESH_OBJ) {
+    fprintf(file, "v %.7g %.7g %.7g\n", v.x, v.y, v.z);
+    return;
+  }
+  fwrite(&v.x, sizeof(float), 3, file);
+}
+
+void mesh_writer_t::triangle(uint32_t a, uint32_t b, uint32_t c) {
+  ++triangles;
+  if (format == MESH_OBJ) {
+    fprintf(file, "f %u %u %u\n", a + 1, b + 1, c + 1);
+    return;
+  }
+  const uint8_t  count     { 3 };
+  const uint32_t index[3] { a, b, c };
+  fwrite(&count, 1, 1, faces);
+  fwrite(index, sizeof(uint32_t), 3, faces);
+}
+
+bool mesh_writer_t::close() {
+  bool ok { true };
+  if (format == MESH_PLY) {
+    char   block[1 << 16];
+    size_t n;
+    rewind(faces);
+    while ((n = fread(block, 1, sizeof(block), faces)) > 0) fwrite(block, 1, n, file);
+    ok = ferror(faces) == 0;
+    fclose(faces);
+    faces = nullptr;
+    fseek(file, 0, SEEK_SET);
+    header();
+  }
+  ok = ok && ferror(file) == 0;
+  fclose(file);
+  file = nullptr;
+  return ok;
+}
+
+// corners of a cell are numbered by their offset bits, x 1, y 2, z 4
+static vec3 corner(int c) {
+  return vec3(c & 1, (c >> 1) & 1, (c >> 2) & 1);
+}
+
+void mesh_export_t::extract(const scene_bvh_t& bvh, int chunk, mesh_chunk_t& out) const {
+  const ivec3 c0 { ivec3(chunk % chunks.x, (chunk / chunks.x) % chunks.y, chunk / (chunks.x * chunks.y)) * MESH_CHUNK };
+  const ivec3 c1 { glm::min(c0 + MESH_CHUNK, cells) };
+  const ivec3 n  { c1 - c0 };
+  const ivec3 np { n + 1 };
+  out.vertices.clear();
+  out.quads.clear();
+  out.seam_keys.clear();
+  out.seam_local.clear();
+  out.empty = true;
+
+  // nothing within the half diagonal of the centre, so every sample has the same sign
+  const vec3 centre { lo + vec3(c0 + c1) * (0.5f * cell) };
+  if (std::abs(bvh.eval(centre)) > 0.5f * length(vec3(n)) * cell * 1.001f) return;
+  out.empty = false;
+
+  // rows along x in packets, the last packet of a row repeats its end point
+  thread_local std::vector<float> samples;
+  thread_local std::vector<int>   local;
+  samples.resize(static_cast<size_t>(np.x) * np.y * np.z);
+  auto sample = [&] (ivec3 q) -> float& { return samples[(static_cast<size_t>(q.z) * np.y + q.y) * np.x + q.x]; };
+  for (int z = 0; z < np.z; ++z) {
+    for (int y = 0; y < np.y; ++y) {
+      const vfloat py { lo.y + static_cast<float>(c0.y + y) * cell };
+      const vfloat pz { lo.z + static_cast<float>(c0.z + z) * cell };
+      for (int x = 0; x < np.x; x += SIMD_WIDTH) {
+        float px[SIMD_WIDTH], d[SIMD_WIDTH];
+        for (int i = 0; i < SIMD_WIDTH; ++i) px[i] = lo.x + static_cast<float>(c0.x + glm::min(x + i, n.x)) * cell;
+        bvh.eval(vvec3(vfloat::load(px), py, pz)).store(d);
+        for (int i = 0; i < SIMD_WIDTH && x + i < np.x; ++i) sample(ivec3(x + i, y, z)) = d[i];
+      }
+    }
+  }
+
+  // a vertex in every cell with corners on both sides, later chunks look up the ones on the
+  // chunk's upper faces by their key
+  local.assign(static_cast<size_t>(n.x) * n.y * n.z, -1);
+  for (int z = 0; z < n.z; ++z) {
+    for (int y = 0; y < n.y; ++y) {
+      for (int x = 0; x < n.x; ++x) {
+        const ivec3 q { x, y, z };
+        float d[8];
+        int   inside { 0 };
+        for (int c = 0; c < 8; ++c) {
+          d[c]    = sample(q + ivec3(corner(c)));
+          inside |= (d[c] < 0.0f) << c;
+        }
+        if (inside == 0 || inside == 255) continue;
+
+        vec3 sum   { 0.0f };
+        int  count { 0 };
+        for (int bit = 1; bit < 8; bit <<= 1) {
+          for (int c = 0; c < 8; ++c) {
+            if ((c & bit) || ((inside >> c) & 1) == ((inside >> (c | bit)) & 1)) continue;
+            sum += corner(c) + (corner(c | bit) - corner(c)) * (d[c] / (d[c] - d[c | bit]));
+            ++count;
+          }
+        }
+        const ivec3 g { c0 + q };
+        local[(static_cast<size_t>(z) * n.y + y) * n.x + x] = static_cast<int>(out.vertices.size());
+        if ((g.x == c1.x - 1 && c1.x < cells.x) || (g.y == c1.y - 1 && c1.y < cells.y) || (g.z == c1.z - 1 && c1.z < cells.z)) {
+          out.seam_keys.push_back(key(g));
+          out.seam_local.push_back(static_cast<uint32_t>(out.vertices.size()));
+        }
+        out.vertices.push_back(lo + (vec3(g) + sum / static_cast<float>(count)) * cell);
+      }
+    }
+  }
+
+  // a quad per crossed edge starting in the chunk, wound so it faces the outside
+  auto ref = [&] (ivec3 g) -> int64_t {
+    if (g.x < c0.x || g.y < c0.y || g.z < c0.z) return -1 - static_cast<int64_t>(key(g));
+    const ivec3 q { g - c0 };
+    return local[(static_cast<size_t>(q.z) * n.y + q.y) * n.x + q.x];
+  };
+  for (int z = c0.z; z < c1.z; ++z) {
+    for (int y = c0.y; y < c1.y; ++y) {
+      for (int x = c0.x; x < c1.x; ++x) {
+        const ivec3 p { x, y, z };
+        for (int a = 0; a < 3; ++a) {
+          const int b { (a + 1) % 3 };
+          const int c { (a + 2) % 3 };
+          if (p[b] < 1 || p[c] < 1) continue; // the grid has no cells behind it
+          ivec3 ea { 0 }, eb { 0 }, ec { 0 };
+          ea[a] = 1;
+          eb[b] = 1;
+          ec[c] = 1;
+          const bool in0 { sample(p - c0) < 0.0f };
+          if (in0 == (sample(p - c0 + ea) < 0.0f)) continue;
+          const int64_t v[4] { ref(p - eb - ec), ref(p - ec), ref(p), ref(p - eb) };
+          if (in0) out.quads.insert(out.quads.end(), { v[0], v[1], v[2], v[3] });
+          else     out.quads.insert(out.quads.end(), { v[0], v[3], v[2], v[1] });
+        }
+      }
+    }
+  }
+}
+
+void mesh_export_t::emit(int chunk, mesh_chunk_t& out, mesh_writer_t& writer) {
+  if (!out.empty) {
+    const uint32_t base { static_cast<uint32_t>(writer.vertices) };
+    for (const vec3& v : out.vertices) writer.vertex(v);
+    for (size_t i = 0; i < out.seam_keys.size(); ++i) seams[out.seam_keys[i]] = base + out.seam_local[i];
+    seam_chunks.emplace_back(chunk, std::move(out.seam_keys));
+    peak_seams = glm::max(peak_seams, seams.size());
+
+    for (size_t q = 0; q < out.quads.size(); q += 4) {
+      uint32_t v[4];
+      bool     found { true };
+      for (int i = 0; i < 4; ++i) {
+        const int64_t r { out.quads[q + i] };
+        if (r >= 0) {
+          v[i] = base + static_cast<uint32_t>(r);
+          continue;
+        }
+        const auto it { seams.find(static_cast<uint64_t>(-1 - r)) };
+        found = found && it != seams.end();
+        if (it != seams.end()) v[i] = it->second;
+      }
+      if (!found) {
+        ++dropped;
+        continue;
+      }
+      writer.triangle(v[0], v[1], v[2]);
+      writer.triangle(v[0], v[2], v[3]);
+    }
+  }
+
+  // the last chunk to reference a chunk's cells is one slab, one row and one chunk later
+  const int reach { 1 + chunks.x + chunks.x * chunks.y };
+  while (!seam_chunks.empty() && seam_chunks.front().first + reach <= chunk) {
+    for (uint64_t k : seam_chunks.front().second) seams.erase(k);
+    seam_chunks.pop_front();
+  }
+}
+
+bool mesh_export_t::run(const scene_bvh_t& bvh, scheduler_t& scheduler, mesh_writer_t& writer) {
+  const auto start { std::chrono::steady_clock::now() };
+  vec3 box_lo, box_hi;
+  if (!bvh.box(box_lo, box_hi)) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "The scene has no bounded objects to mesh");
+    return false;
+  }
+
+  const vec3 extent { box_hi - box_lo };
+  cell   = glm::max(extent.x, glm::max(extent.y, extent.z)) / static_cast<float>(glm::max(1, resolution - 2 * MESH_PAD));
+  cells  = glm::max(ivec3(1), ivec3(glm::ceil(extent / cell))) + 2 * MESH_PAD;
+  lo     = box_lo - static_cast<float>(MESH_PAD) * cell;
+  chunks = (cells + MESH_CHUNK - 1) / MESH_CHUNK;
+  empty_chunks = 0;
+  peak_seams   = 0;
+  dropped      = 0;
+
+  // chunks go in order a batch at a time, so a chunk's neighbours below it are numbered first
+  const int num_chunks { chunks.x * chunks.y * chunks.z };
+  const int batch      { scheduler.num_workers() * MESH_BATCH };
+  std::vector<mesh_chunk_t> out(batch);
+  for (int first = 0; first < num_chunks; first += batch) {
+    const int count { glm::min(batch, num_chunks - first) };
+    scheduler.run(count, [&] (int i) { extract(bvh, first + i, out[i]); });
+    for (int i = 0; i < count; ++i) {
+      empty_chunks += out[i].empty;
+      emit(first + i, out[i], writer);
+    }
+  }
+  seams.clear();
+  seam_chunks.clear();
+
+  ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+  return true;
+}
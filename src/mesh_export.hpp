@@ -0,0 +1,78 @@
+#ifndef _MESH_EXPORT_H_
+#define _MESH_EXPORT_H_
+
+#include "main.hpp"
+#include "bvh.hpp"
+#include "scheduler.hpp"
+
+#include <cstdio>
+#include <deque>
+#include <unordered_map>
+#include <vector>
+
+// cells along a chunk's edge, a chunk's samples are (MESH_CHUNK + 1)^3 floats per worker
+#define MESH_CHUNK      32
+// chunks extracted per worker before their output is numbered and written, with the seam
+// map this is all the memory the export holds whatever the resolution
+#define MESH_BATCH      4
+// cells of padding around the scene's box so surfaces close inside the grid
+#define MESH_PAD        2
+
+enum mesh_format_t {
+  MESH_PLY = 0, // binary little endian, the counts are patched into the header at the end
+  MESH_OBJ
+};
+
+// streams an indexed triangle mesh to disk, PLY keeps its faces in a temporary file until
+// the vertices are all written
+struct mesh_writer_t {
+  FILE*         file      { nullptr };
+  FILE*         faces     { nullptr };
+  mesh_format_t format    { MESH_PLY };
+  uint64_t      vertices  { 0 };
+  uint64_t      triangles { 0 };
+
+  bool open     (const char*); // the format follows the extension, .obj or anything else for PLY
+  void vertex   (vec3);
+  void triangle (uint32_t, uint32_t, uint32_t);
+  bool close    (void);
+  void header   (void);
+};
+
+// what one chunk found before the vertices are numbered. a quad's corners are the vertices
+// of the four cells around an edge, the chunk's own as local indices and the cells of earlier
+// chunks as -1 - their cell key
+struct mesh_chunk_t {
+  std::vector<vec3>     vertices;
+  std::vector<int64_t>  quads;
+  std::vector<uint64_t> seam_keys;  // own cells later chunks reference, with their local index
+  std::vector<uint32_t> seam_local;
+  bool                  empty { true };
+};
+
+// surface nets over a grid covering the scene's bounded objects: one vertex per cell the
+// surface crosses, at the mean of its edge crossings, and a quad per crossed edge joining
+// the four cells around it. chunks whose centre is further from the surface than their
+// half diagonal are skipped without sampling. a chunk owns the edges starting in its cells,
+// so every vertex and quad is made once and seams are shared through the cell keys
+struct mesh_export_t {
+  int      resolution   { 256 }; // cells along the longest side of the grid
+  vec3     lo           { 0.0f };
+  float    cell         { 0.0f };
+  ivec3    cells        { 0 };
+  ivec3    chunks       { 0 };
+  int      empty_chunks { 0 };
+  size_t   peak_seams   { 0 };   // largest the seam map got
+  uint64_t dropped      { 0 };   // quads whose cells a skipped chunk should have had
+  double   ms           { 0.0 };
+
+  std::unordered_map<uint64_t, uint32_t>            seams;       // cell key to vertex, for later chunks
+  std::deque<std::pair<int, std::vector<uint64_t>>> seam_chunks; // keys to drop as chunks retire
+
+  bool     run     (const scene_bvh_t&, scheduler_t&, mesh_writer_t&); // the bvh built on the bound scene
+  void     extract (const scene_bvh_t&, int, mesh_chunk_t&) const;
+  void     emit    (int, mesh_chunk_t&, mesh_writer_t&); // takes the chunk's seam keys
+  uint64_t key     (ivec3 c) const { return (static_cast<uint64_t>(c.z) * cells.y + c.y) * cells.x + c.x; }
+};
+
+#endif // _MESH_EXPORT_H_
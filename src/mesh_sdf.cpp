@@ -0,0 +1,490 @@
+#include "mesh_sdf.hpp"
+
+#include <algorithm>
+#include <chrono>
+
+// reading
+
+static bool add_polygon(tri_mesh_t& mesh, const std::vector<int64_t>& polygon, const char* path) {
+  for (int64_t i : polygon) {
+    if (i < 0 || i >= static_cast<int64_t>(mesh.positions.size())) {
+      SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "%s: face refers to vertex %lld of %zu", path,
+                   static_cast<long long>(i), mesh.positions.size());
+      return false;
+    }
+  }
+  for (size_t i = 2; i < polygon.size(); ++i)
+    mesh.triangles.push_back(uvec3(polygon[0], polygon[i - 1], polygon[i]));
+  return true;
+}
+
+// v and f lines, the texture and normal indices of a face's corners are ignored
+static bool load_obj(tri_mesh_t& mesh, const char* src, const char* path) {
+  std::vector<int64_t> polygon;
+  for (const char* line = src; *line; ) {
+    const char* end { line + strcspn(line, "\n") };
+    if (line[0] == 'v' && line[1] == ' ') {
+      vec3 v { 0.0f };
+      char* p { const_cast<char*>(line + 2) };
+      for (int i = 0; i < 3; ++i) v[i] = strtof(p, &p);
+      mesh.positions.push_back(v);
+    } else if (line[0] == 'f' && line[1] == ' ') {
+      polygon.clear();
+      char* p { const_cast<char*>(line + 2) };
+      for (;;) {
+        char* next;
+        const long long i { strtoll(p, &next, 10) };
+        if (next == p || next > end) break;
+        // counted from one, negative ones from the last vertex so far
+        polygon.push_back(i < 0 ? static_cast<int64_t>(mesh.positions.size()) + i : i - 1);
+        p = next;
+        while (*p && !strchr(" \t\r\n", *p)) ++p;
+      }
+      if (!add_polygon(mesh, polygon, path)) return false;
+    }
+    line = *end ? end + 1 : end;
+  }
+  return true;
+}
+
+struct ply_property_t {
+  int         type       { -1 };
+  int         count_type { -1 }; // the type of a list's length, -1 for scalars
+  std::string name;
+};
+
+struct ply_element_t {
+  std::string                 name;
+  size_t                      count { 0 };
+  std::vector<ply_property_t> properties;
+};
+
+struct ply_type_t {
+  const char* names[2];
+  int         size;
+  bool        is_float;
+  bool        is_signed;
+};
+
+constexpr ply_type_t ply_types[] {
+  { { "char",   "int8"    }, 1, false, true  },
+  { { "uchar",  "uint8"   }, 1, false, false },
+  { { "short",  "int16"   }, 2, false, true  },
+  { { "ushort", "uint16"  }, 2, false, false },
+  { { "int",    "int32"   }, 4, false, true  },
+  { { "uint",   "uint32"  }, 4, false, false },
+  { { "float",  "float32" }, 4, true,  true  },
+  { { "double", "float64" }, 8, true,  true  },
+};
+
+static int ply_type(const char* name) {
+  for (int t = 0; t < static_cast<int>(sizeof(ply_types) / sizeof(ply_types[0])); ++t)
+    if (strcmp(name, ply_types[t].names[0]) == 0 || strcmp(name, ply_types[t].names[1]) == 0) return t;
+  return -1;
+}
+
+// one value of the body, binary ones are little endian like the machines this runs on
+struct ply_reader_t {
+  const char* p;
+  const char* end;
+  bool        ascii;
+  bool        failed { false };
+
+  double read(int type) {
+    const ply_type_t& t { ply_types[type] };
+    if (ascii) {
+      char* next;
+      const double v { strtod(p, &next) };
+      failed = failed || next == p;
+      p = next;
+      return v;
+    }
+    if (end - p < t.size) {
+      failed = true;
+      return 0.0;
+    }
+    uint8_t bytes[8] {};
+    memcpy(bytes, p, static_cast<size_t>(t.size));
+    p += t.size;
+    if (t.is_float) {
+      if (t.size == 4) { float f; memcpy(&f, bytes, 4); return f; }
+      double d; memcpy(&d, bytes, 8); return d;
+    }
+    uint64_t u { 0 };
+    for (int i = t.size - 1; i >= 0; --i) u = (u << 8) | bytes[i];
+    if (t.is_signed && (bytes[t.size - 1] & 0x80)) return static_cast<double>(static_cast<int64_t>(u | (~0ull << (8 * t.size))));
+    return static_cast<double>(u);
+  }
+};
+
+static bool load_ply(tri_mesh_t& mesh, const char* src, size_t size, const char* path) {
+  const char* body { strstr(src, "end_header") };
+  if (strncmp(src, "ply", 3) != 0 || body == nullptr) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "%s: not a PLY file", path);
+    return false;
+  }
+  body = strchr(body, '\n');
+  body = body ? body + 1 : src + size;
+
+  std::vector<ply_element_t> elements;
+  bool ascii { false };
+  const std::string header { src, body };
+  for (size_t at = 0; at < header.size(); ) {
+    size_t eol { header.find('\n', at) };
+    if (eol == std::string::npos) eol = header.size();
+    char word[5][64] {};
+    const int words { sscanf(header.substr(at, eol - at).c_str(), "%63s %63s %63s %63s %63s",
+                             word[0], word[1], word[2], word[3], word[4]) };
+    at = eol + 1;
+    if (words >= 2 && strcmp(word[0], "format") == 0) {
+      ascii = strcmp(word[1], "ascii") == 0;
+      if (!ascii && strcmp(word[1], "binary_little_endian") != 0) {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "%s: PLY format `%s` isn't supported", path, word[1]);
+        return false;
+      }
+    } else if (words == 3 && strcmp(word[0], "element") == 0) {
+      ply_element_t e {};
+      e.name  = word[1];
+      e.count = strtoull(word[2], nullptr, 10);
+      elements.push_back(e);
+    } else if (words >= 3 && strcmp(word[0], "property") == 0 && !elements.empty()) {
+      ply_property_t prop {};
+      const bool list { strcmp(word[1], "list") == 0 };
+      if (list) {
+        prop.count_type = ply_type(word[2]);
+        prop.type       = words == 5 ? ply_type(word[3]) : -1;
+        prop.name       = word[4];
+      } else {
+        prop.type = ply_type(word[1]);
+        prop.name = word[2];
+      }
+      if (prop.type < 0 || (list && prop.count_type < 0)) {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "%s: unknown PLY property type for `%s`", path,
+                     list ? word[4] : word[2]);
+        return false;
+      }
+      elements.back().properties.push_back(prop);
+    }
+  }
+
+  ply_reader_t         reader { body, src + size, ascii };
+  std::vector<int64_t> polygon;
+  for (const ply_element_t& e : elements) {
+    const bool vertices { e.name == "vertex" };
+    const bool faces    { e.name == "face" };
+    for (size_t i = 0; i < e.count && !reader.failed; ++i) {
+      vec3 v { 0.0f };
+      for (const ply_property_t& prop : e.properties) {
+        if (prop.count_type < 0) {
+          const double value { reader.read(prop.type) };
+          if (vertices && prop.name.size() == 1 && strchr("xyz", prop.name[0]))
+            v[static_cast<int>(prop.name[0] - 'x')] = static_cast<float>(value);
+          continue;
+        }
+        const bool indices { faces && (prop.name == "vertex_indices" || prop.name == "vertex_index") };
+        const int  count   { static_cast<int>(reader.read(prop.count_type)) };
+        if (indices) polygon.clear();
+        for (int j = 0; j < count && !reader.failed; ++j) {
+          const double value { reader.read(prop.type) };
+          if (indices) polygon.push_back(static_cast<int64_t>(value));
+        }
+        if (indices && !reader.failed && !add_polygon(mesh, polygon, path)) return false;
+      }
+      if (vertices) mesh.positions.push_back(v);
+    }
+  }
+  if (reader.failed) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "%s: PLY body ends early", path);
+    return false;
+  }
+  return true;
+}
+
+bool tri_mesh_t::load(const char* path) {
+  positions.clear();
+  triangles.clear();
+  if (get_last_modified_time(path) == 0) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Could not open mesh `%s`", path);
+    return false;
+  }
+  size_t size { 0 };
+  char*  src  { slurp_file(path, &size) };
+  const char* ext { strrchr(path, '.') };
+  const bool  ok  { ext && strcasecmp(ext, ".obj") == 0 ? load_obj(*this, src, path) : load_ply(*this, src, size, path) };
+  free(static_cast<void*>(src));
+  if (ok && triangles.empty()) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "%s: mesh has no triangles", path);
+    return false;
+  }
+  return ok;
+}
+
+// the triangle bvh
+
+static void build_tri_node(tri_bvh_t& bvh, const std::vector<vec3>& centroids, int node, int first, int last) {
+  const tri_mesh_t& mesh { *bvh.mesh };
+  tri_node_t        n    {};
+  n.lo = vec3(INFINITY);
+  n.hi = vec3(-INFINITY);
+  float area { 0.0f };
+  vec3  lo_c { INFINITY }, hi_c { -INFINITY };
+  for (int i = first; i < last; ++i) {
+    const uvec3 t { mesh.triangles[bvh.order[i]] };
+    const vec3  a { mesh.positions[t.x] }, b { mesh.positions[t.y] }, c { mesh.positions[t.z] };
+    const vec3  normal { 0.5f * cross(b - a, c - a) };
+    n.lo      = glm::min(n.lo, glm::min(a, glm::min(b, c)));
+    n.hi      = glm::max(n.hi, glm::max(a, glm::max(b, c)));
+    n.normal += normal;
+    n.centre += length(normal) * centroids[bvh.order[i]];
+    area     += length(normal);
+    lo_c      = glm::min(lo_c, centroids[bvh.order[i]]);
+    hi_c      = glm::max(hi_c, centroids[bvh.order[i]]);
+  }
+  n.centre = area > 0.0f ? n.centre / area : 0.5f * (n.lo + n.hi);
+  for (int i = first; i < last; ++i) {
+    const uvec3 t { mesh.triangles[bvh.order[i]] };
+    for (int k = 0; k < 3; ++k) n.radius = glm::max(n.radius, length(mesh.positions[t[k]] - n.centre));
+  }
+
+  if (last - first <= MESH_SDF_LEAF) {
+    n.first = first;
+    n.count = last - first;
+    bvh.nodes[node] = n;
+    return;
+  }
+
+  // median of the centroids along the axis they spread the most
+  const vec3 extent { hi_c - lo_c };
+  const int  axis   { extent.x >= extent.y && extent.x >= extent.z ? 0 : extent.y >= extent.z ? 1 : 2 };
+  const int  mid    { (first + last) / 2 };
+  std::nth_element(bvh.order.begin() + first, bvh.order.begin() + mid, bvh.order.begin() + last, [&] (int a, int b) {
+    return centroids[a][axis] < centroids[b][axis];
+  });
+
+  n.child = static_cast<int>(bvh.nodes.size());
+  bvh.nodes[node] = n;
+  bvh.nodes.resize(bvh.nodes.size() + 2);
+  build_tri_node(bvh, centroids, n.child,     first, mid);
+  build_tri_node(bvh, centroids, n.child + 1, mid,   last);
+}
+
+void tri_bvh_t::build(const tri_mesh_t& m) {
+  mesh = &m;
+  std::vector<vec3> centroids(m.triangles.size());
+  order.resize(m.triangles.size());
+  for (size_t i = 0; i < m.triangles.size(); ++i) {
+    const uvec3 t { m.triangles[i] };
+    centroids[i] = (m.positions[t.x] + m.positions[t.y] + m.positions[t.z]) / 3.0f;
+    order[i]     = static_cast<int>(i);
+  }
+  nodes.assign(1, tri_node_t {});
+  build_tri_node(*this, centroids, 0, 0, static_cast<int>(order.size()));
+}
+
+static float box_distance2(const tri_node_t& n, vec3 p) {
+  const vec3 d { glm::max(glm::max(n.lo - p, p - n.hi), vec3(0.0f)) };
+  return dot(d, d);
+}
+
+// closest point on the triangle by the voronoi regions of its corners and edges, Ericson's
+static float triangle_distance2(vec3 p, vec3 a, vec3 b, vec3 c) {
+  const vec3  ab { b - a }, ac { c - a }, ap { p - a };
+  const float d1 { dot(ab, ap) }, d2 { dot(ac, ap) };
+  if (d1 <= 0.0f && d2 <= 0.0f) return dot(ap, ap);
+
+  const vec3  bp { p - b };
+  const float d3 { dot(ab, bp) }, d4 { dot(ac, bp) };
+  if (d3 >= 0.0f && d4 <= d3) return dot(bp, bp);
+
+  const float vc { d1*d4 - d3*d2 };
+  if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f) {
+    const vec3 e { ap - ab * (d1 / (d1 - d3)) };
+    return dot(e, e);
+  }
+
+  const vec3  cp { p - c };
+  const float d5 { dot(ab, cp) }, d6 { dot(ac, cp) };
+  if (d6 >= 0.0f && d5 <= d6) return dot(cp, cp);
+
+  const float vb { d5*d2 - d1*d6 };
+  if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f) {
+    const vec3 e { ap - ac * (d2 / (d2 - d6)) };
+    return dot(e, e);
+  }
+
+  const float va { d3*d6 - d5*d4 };
+  if (va <= 0.0f && d4 - d3 >= 0.0f && d5 - d6 >= 0.0f) {
+    const vec3 e { bp - (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6))) };
+    return dot(e, e);
+  }
+
+  const float denom { 1.0f / (va + vb + vc) };
+  const vec3  e     { ap - ab * (vb * denom) - ac * (vc * denom) };
+  return dot(e, e);
+}
+
+float tri_bvh_t::distance(vec3 p, float upper) const {
+  float best { upper * upper };
+  int   stack[MESH_SDF_STACK];
+  int   top { 0 };
+  stack[top++] = 0;
+  while (top > 0) {
+    const tri_node_t& n { nodes[stack[--top]] };
+    if (box_distance2(n, p) >= best) continue;
+    if (n.child < 0) {
+      for (int i = n.first; i < n.first + n.count; ++i) {
+        const uvec3 t { mesh->triangles[order[i]] };
+        best = glm::min(best, triangle_distance2(p, mesh->positions[t.x], mesh->positions[t.y], mesh->positions[t.z]));
+      }
+      continue;
+    }
+    // the nearer child goes on top
+    const float d0 { box_distance2(nodes[n.child], p) };
+    const float d1 { box_distance2(nodes[n.child + 1], p) };
+    stack[top++] = d0 < d1 ? n.child + 1 : n.child;
+    stack[top++] = d0 < d1 ? n.child : n.child + 1;
+  }
+  return glm::min(sqrt(best), upper);
+}
+
+// solid angle of the triangle seen from the origin, Van Oosterom and Strackee's
+static float solid_angle(vec3 a, vec3 b, vec3 c) {
+  const float la { length(a) }, lb { length(b) }, lc { length(c) };
+  const float num { dot(a, cross(b, c)) };
+  const float den { la*lb*lc + dot(a, b)*lc + dot(b, c)*la + dot(c, a)*lb };
+  return 2.0f * atan2(num, den);
+}
+
+float tri_bvh_t::winding(vec3 p) const {
+  float angle { 0.0f };
+  int   stack[MESH_SDF_STACK];
+  int   top { 0 };
+  stack[top++] = 0;
+  while (top > 0) {
+    const tri_node_t& n { nodes[stack[--top]] };
+    const vec3  d    { n.centre - p };
+    const float dist { length(d) };
+    if (dist > MESH_SDF_BETA * n.radius) {
+      angle += dot(n.normal, d) / (dist * dist * dist);
+      continue;
+    }
+    if (n.child < 0) {
+      for (int i = n.first; i < n.first + n.count; ++i) {
+        const uvec3 t { mesh->triangles[order[i]] };
+        angle += solid_angle(mesh->positions[t.x] - p, mesh->positions[t.y] - p, mesh->positions[t.z] - p);
+      }
+      continue;
+    }
+    stack[top++] = n.child;
+    stack[top++] = n.child + 1;
+  }
+  return angle / (4.0f * glm::pi<float>());
+}
+
+// the volume
+
+void mesh_sdf_t::bake(const tri_mesh_t& mesh, scheduler_t& scheduler) {
+  const auto start { std::chrono::steady_clock::now() };
+  tri_bvh_t bvh {};
+  bvh.build(mesh);
+  triangles = mesh.triangles.size();
+
+  // a cube around the mesh's box, centred on it
+  const vec3  extent { bvh.nodes[0].hi - bvh.nodes[0].lo };
+  const float side   { glm::max(glm::max(extent.x, glm::max(extent.y, extent.z)), 1e-6f) };
+  constexpr int n { MESH_SDF_SAMPLES };
+  cell = side / static_cast<float>(n - 1 - 2 * MESH_SDF_PAD);
+  lo   = 0.5f * (bvh.nodes[0].lo + bvh.nodes[0].hi) - vec3(0.5f * cell * static_cast<float>(n - 1));
+
+  samples.resize(static_cast<size_t>(n) * n * n);
+  scheduler.run(n, [&] (int z) {
+    for (int y = 0; y < n; ++y) {
+      float d { INFINITY };
+      for (int x = 0; x < n; ++x) {
+        // the distance moves by at most a cell from the last sample's, which prunes most of the tree
+        const vec3 p { lo + vec3(x, y, z) * cell };
+        d = bvh.distance(p, d + cell * 1.001f);
+        samples[(static_cast<size_t>(z) * n + y) * n + x] = bvh.winding(p) > 0.5f ? -d : d;
+      }
+    }
+  });
+
+  bake_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+float mesh_sdf_t::sample(vec3 q) const {
+  constexpr int n { MESH_SDF_SAMPLES };
+  const vec3 g { (q - lo) / cell };
+  const ivec3 c { glm::min(ivec3(g), ivec3(n - 2)) };
+  const vec3  f { g - vec3(c) };
+  auto at = [&] (int x, int y, int z) {
+    return samples[(static_cast<size_t>(c.z + z) * n + c.y + y) * n + c.x + x];
+  };
+  const float x00 { mix(at(0, 0, 0), at(1, 0, 0), f.x) };
+  const float x10 { mix(at(0, 1, 0), at(1, 1, 0), f.x) };
+  const float x01 { mix(at(0, 0, 1), at(1, 0, 1), f.x) };
+  const float x11 { mix(at(0, 1, 1), at(1, 1, 1), f.x) };
+  return mix(mix(x00, x10, f.y), mix(x01, x11, f.y), f.z);
+}
+
+float mesh_sdf_t::eval(vec3 p) const {
+  const vec3  q { glm::clamp(p, lo, lo + vec3(cell * static_cast<float>(MESH_SDF_SAMPLES - 1))) };
+  const float d { sample(q) };
+  const vec3 out { p - q };
+  return out == vec3(0.0f) ? d : sqrt(dot(out, out) + d * d);
+}
+
+// central differences of the samples half a cell either side, like Mesh_dual() in fragment.glsl
+vec4 mesh_sdf_t::eval_dual(vec3 p) const {
+  const vec3  hi { lo + vec3(cell * static_cast<float>(MESH_SDF_SAMPLES - 1)) };
+  const vec3  q  { glm::clamp(p, lo, hi) };
+  const float d  { sample(q) };
+  vec3 g;
+  for (int i = 0; i < 3; ++i) {
+    vec3 e { 0.0f };
+    e[i] = 0.5f * cell;
+    const vec3 a { glm::min(q + e, hi) };
+    const vec3 b { glm::max(q - e, lo) };
+    g[i] = (sample(a) - sample(b)) / (a[i] - b[i]);
+  }
+  const vec3 out { p - q };
+  if (out == vec3(0.0f)) return vec4(d, g);
+  const float l { sqrt(dot(out, out) + d * d) };
+  return vec4(l, (out + d * g * vec3(equal(p, q))) / l);
+}
+
+// no gathers, the lanes sample one at a time
+vfloat mesh_sdf_t::eval(const vvec3& p) const {
+  float x[SIMD_WIDTH], y[SIMD_WIDTH], z[SIMD_WIDTH], d[SIMD_WIDTH];
+  p.x.store(x);
+  p.y.store(y);
+  p.z.store(z);
+  for (int i = 0; i < SIMD_WIDTH; ++i) d[i] = eval(vec3(x[i], y[i], z[i]));
+  return vfloat::load(d);
+}
+
+std::shared_ptr<const mesh_sdf_t> load_mesh_sdf(const char* path) {
+  static std::vector<std::shared_ptr<const mesh_sdf_t>> baked;
+  const uint64_t modified { get_last_modified_time(path) };
+  for (const auto& volume : baked)
+    if (volume->path == path && volume->modified == modified) return volume;
+
+  tri_mesh_t mesh {};
+  if (!mesh.load(path)) return nullptr;
+
+  auto volume { std::make_shared<mesh_sdf_t>() };
+  volume->path     = path;
+  volume->modified = modified;
+  {
+    scheduler_t scheduler {};
+    volume->bake(mesh, scheduler);
+  }
+  SDL_Log("%s: %zu triangles baked to %d^3 samples in %.1f ms", path, volume->triangles, MESH_SDF_SAMPLES, volume->bake_ms);
+
+  // an edited file replaces its old volume, scenes still using that one keep it alive
+  baked.erase(std::remove_if(baked.begin(), baked.end(), [&] (const std::shared_ptr<const mesh_sdf_t>& v) {
+    return v->path == path;
+  }), baked.end());
+  baked.push_back(volume);
+  return volume;
+}
@@ -0,0 +1,84 @@
+#ifndef _MESH_SDF_H_
+#define _MESH_SDF_H_
+
+#include "main.hpp"
+#include "scheduler.hpp"
+#include "simd.hpp"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+// samples along each side of a mesh's volume, the scene's volumes share one atlas of
+// MESH_SDF_ATLAS texels a side, which is what GL 3.3 guarantees for 3D textures
+#define MESH_SDF_SAMPLES 64
+#define MESH_SDF_ATLAS   256
+#define MESH_SDF_SLOTS   ((MESH_SDF_ATLAS / MESH_SDF_SAMPLES) * (MESH_SDF_ATLAS / MESH_SDF_SAMPLES) * (MESH_SDF_ATLAS / MESH_SDF_SAMPLES))
+// samples of padding around the mesh's box, so the surface closes inside the volume
+#define MESH_SDF_PAD     3
+// triangles a leaf of the triangle bvh holds at most
+#define MESH_SDF_LEAF    4
+// pending nodes of a query, twice the depth of a median split tree over millions of triangles
+#define MESH_SDF_STACK   64
+// a node further away than this many radii counts as its dipole in the winding number
+#define MESH_SDF_BETA    2.0f
+
+// an indexed triangle mesh, polygons are split into fans as they're read
+struct tri_mesh_t {
+  std::vector<vec3>  positions;
+  std::vector<uvec3> triangles;
+
+  bool load (const char*); // OBJ when the extension says so, PLY (ascii or binary little endian) otherwise
+};
+
+// a node bounds its triangles by a box for the distance and by a ball around their area
+// weighted centroid for the winding number, normal is their area weighted normals summed
+struct tri_node_t {
+  vec3  lo     { 0.0f };
+  vec3  hi     { 0.0f };
+  vec3  centre { 0.0f };
+  vec3  normal { 0.0f };
+  float radius { 0.0f };
+  int   child  { -1 };   // the first of two adjacent children, -1 for leaves
+  int   first  { 0 };    // a leaf's triangles in order
+  int   count  { 0 };
+};
+
+// median split tree over the triangles, closest point queries descend into the boxes nearer
+// than the best distance so far. the winding number is the fast approximation of Barill et al:
+// exact solid angles for the triangles nearby, far nodes as a dipole at their centroid
+struct tri_bvh_t {
+  const tri_mesh_t*       mesh { nullptr };
+  std::vector<tri_node_t> nodes; // root first
+  std::vector<int>        order; // triangles in leaf order
+
+  void  build    (const tri_mesh_t&); // keeps a pointer to the mesh
+  float distance (vec3, float = INFINITY) const; // unsigned, to the closest triangle, at most the given bound
+  float winding  (vec3) const;        // about 1 inside a closed mesh and 0 outside
+};
+
+// a mesh's signed distance sampled on a cube of MESH_SDF_SAMPLES^3 around it, negative where
+// its winding number is above a half so meshes with holes still get an inside. outside the cube
+// it's the distance to the cube and the sample at the nearest point on it, combined by
+// pythagoras, which never overestimates as long as the surface is inside the cube
+struct mesh_sdf_t {
+  std::string        path;
+  uint64_t           modified  { 0 };
+  vec3               lo        { 0.0f };
+  float              cell      { 0.0f };
+  std::vector<float> samples;         // x fastest
+  size_t             triangles { 0 };
+  double             bake_ms   { 0.0 };
+
+  void   bake      (const tri_mesh_t&, scheduler_t&);
+  float  sample    (vec3) const; // trilinear, inside the cube
+  float  eval      (vec3) const;
+  vfloat eval      (const vvec3&) const;
+  vec4   eval_dual (vec3) const; // distance and gradient, the samples' by central differences
+};
+
+// the file's volume, baked on every core the first time and again only once the file changed.
+// null after logging why when it can't be read
+std::shared_ptr<const mesh_sdf_t> load_mesh_sdf(const char*);
+
+#endif // _MESH_SDF_H_
@@ -0,0 +1,106 @@
+#include "program_cache.hpp"
+
+#include <vector>
+
+struct program_cache_header_t {
+  uint32_t magic;
+  uint32_t format;
+  uint32_t length;
+};
+
+static std::string cache_file(uint64_t key) {
+  char path[256];
+  snprintf(path, sizeof(path), "%s/%016llx.bin", PROGRAM_CACHE_DIR, static_cast<unsigned long long>(key));
+  return path;
+}
+
+program_cache_t::program_cache_t() {
+  GLint formats { 0 };
+  if (GLEW_ARB_get_program_binary) glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+  enabled = formats > 0;
+  if (!enabled) {
+    SDL_Log("program binaries are not supported, shaders are compiled on every start");
+    return;
+  }
+
+  for (GLenum name : { GL_VENDOR, GL_RENDERER, GL_VERSION }) {
+    const GLubyte* s { glGetString(name) };
+    driver += s ? reinterpret_cast<const char*>(s) : "";
+    driver += '\n';
+  }
+}
+
+uint64_t program_cache_t::key(const char* vertex, const std::string& fragment) const {
+  uint64_t h { hash_bytes(vertex, strlen(vertex)) };
+  h = hash_bytes(fragment.data(), fragment.size(), h);
+  return hash_bytes(driver.data(), driver.size(), h);
+}
+
+bool program_cache_t::load(GLuint program, uint64_t key) {
+  if (!enabled) return false;
+
+  FILE* f { fopen(cache_file(key).c_str(), "rb") };
+  if (!f) return false;
+
+  program_cache_header_t header {};
+  std::vector<uint8_t>   binary;
+  bool ok { fread(&header, sizeof(header), 1, f) == 1 && header.magic == PROGRAM_CACHE_MAGIC };
+  if (ok) {
+    binary.resize(header.length);
+    ok = fread(binary.data(), 1, binary.size(), f) == binary.size();
+  }
+  fclose(f);
+  if (!ok) return false;
+
+  glProgramBinary(program, header.format, binary.data(), static_cast<GLsizei>(binary.size()));
+  GLint linked { GL_FALSE };
+  glGetProgramiv(program, GL_LINK_STATUS, &linked);
+  return linked == GL_TRUE; // a driver update can reject it even with the same strings
+}
+
+void program_cache_t::store(GLuint program, uint64_t key) {
+  if (!enabled) return;
+
+  GLint length { 0 };
+  glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+  if (length <= 0) return;
+
+  std::vector<uint8_t> binary(static_cast<size_t>(length));
+  GLenum format { 0 };
+  glGetProgramBinary(program, length, NULL, &format, binary.data());
+
+  make_dir(PROGRAM_CACHE_DIR); // fails harmlessly when it exists
+  // written under a temporary name so a crash never leaves a truncated entry behind
+  const std::string path { cache_file(key) };
+  const std::string tmp  { path + ".tmp" };
+  FILE* f { fopen(tmp.c_str(), "wb") };
+  if (!f) {
+    SDL_Log("Could not write program cache `%s`", tmp.c_str());
+    return;
+  }
+
+  const program_cache_header_t header { PROGRAM_CACHE_MAGIC, format, static_cast<uint32_t>(length) };
+  bool ok { fwrite(&header, sizeof(header), 1, f) == 1 };
+  ok = ok && fwrite(binary.data(), 1, binary.size(), f) == binary.size();
+  ok = (fclose(f) == 0) && ok;
+  remove(path.c_str()); // rename doesn't replace on windows
+  if (!ok || rename(tmp.c_str(), path.c_str()) != 0) remove(tmp.c_str());
+}
+
+std::string preprocess_source(const char* src, size_t size) {
+  std::string out;
+  out.reserve(size);
+  for (size_t i = 0; i < size; ++i) {
+    if (src[i] == '/' && i + 1 < size && src[i + 1] == '/') {
+      while (i < size && src[i] != '\n') ++i;
+      if (i < size) out += '\n';
+    } else if (src[i] == '/' && i + 1 < size && src[i + 1] == '*') {
+      for (i += 2; i < size && !(src[i] == '*' && i + 1 < size && src[i + 1] == '/'); ++i)
+        if (src[i] == '\n') out += '\n';
+      ++i; // the closing slash
+    } else {
+      out += src[i];
+    }
+  }
+  return out;
+}
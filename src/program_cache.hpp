@@ -0,0 +1,28 @@
+#ifndef _PROGRAM_CACHE_H_
+#define _PROGRAM_CACHE_H_
+
+#include "main.hpp"
+
+#include <string>
+
+#define PROGRAM_CACHE_DIR   "./shader_cache"
+#define PROGRAM_CACHE_MAGIC 0x50464453u // "SDFP"
+
+// linked programs on disk, one file per key. binaries are only valid for the driver that
+// made them so the driver strings are part of the key, and a binary the driver still
+// rejects just falls back to compiling
+struct program_cache_t {
+  bool        enabled { false };
+  std::string driver; // GL_VENDOR, GL_RENDERER and GL_VERSION
+
+  program_cache_t (void);
+
+  uint64_t key   (const char*, const std::string&) const; // vertex and preprocessed fragment source
+  bool     load  (GLuint, uint64_t);
+  void     store (GLuint, uint64_t);
+};
+
+// what the cache key and the driver see: comments stripped, newlines kept so error line numbers still match
+std::string preprocess_source(const char*, size_t);
+
+#endif // _PROGRAM_CACHE_H_
@@ -0,0 +1,136 @@
+#include "readback.hpp"
+
+readback_t::readback_t(readback_consumer_t fn) : consumer(std::move(fn)) {
+  glGenBuffers(READBACK_BUFFERS, pbo);
+  consumer_thread = std::thread(&readback_t::consumer_loop, this);
+}
+
+readback_t::~readback_t() {
+  flush();
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    quit = true;
+  }
+  queued_cv.notify_all();
+  consumer_thread.join();
+  glDeleteBuffers(READBACK_BUFFERS, pbo);
+}
+
+void readback_t::capture(framebuffer_t& fb, int index) {
+  if (fb.width != width || fb.height != height) {
+    flush();
+    width  = fb.width;
+    height = fb.height;
+    for (int i = 0; i < READBACK_BUFFERS; ++i) {
+      glBindBuffer(GL_PIXEL_PACK_BUFFER, pbo[i]);
+      glBufferData(GL_PIXEL_PACK_BUFFER, static_cast<GLsizeiptr>(width) * height * 4, NULL, GL_STREAM_READ);
+    }
+  }
+
+  // every buffer still in flight, the oldest one has had two frames to finish
+  if (pending == READBACK_BUFFERS) {
+    ++stalls;
+    retire(true);
+  }
+
+  const int slot { (oldest + pending) % READBACK_BUFFERS };
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, fb.fbo);
+  glReadBuffer(GL_COLOR_ATTACHMENT0);
+  glPixelStorei(GL_PACK_ALIGNMENT, 1);
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, pbo[slot]);
+  glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, NULL); // returns as soon as the copy is queued
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+
+  fence[slot]    = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  frame_of[slot] = index;
+  ++pending;
+  glFlush(); // make sure the fence reaches the GPU so polling it can ever succeed
+
+  poll();
+}
+
+void readback_t::poll() {
+  while (pending > 0) {
+    const GLenum status { glClientWaitSync(fence[oldest], 0, 0) };
+    if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) break;
+    retire(false);
+  }
+}
+
+void readback_t::flush() {
+  while (pending > 0) retire(true);
+
+  std::unique_lock<std::mutex> lock(mutex);
+  consumed_cv.wait(lock, [this] { return queue.empty() && !busy; });
+}
+
+// maps the oldest buffer and queues a copy of it for the consumer
+void readback_t::retire(bool wait) {
+  const int slot { oldest };
+  if (wait) {
+    while (glClientWaitSync(fence[slot], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000) == GL_TIMEOUT_EXPIRED) {}
+  }
+  glDeleteSync(fence[slot]);
+  fence[slot] = 0;
+
+  readback_frame_t frame {};
+  {
+    // apply back pressure when the consumer can't keep up instead of growing without bound
+    std::unique_lock<std::mutex> lock(mutex);
+    if (queue.size() >= READBACK_MAX_QUEUED) {
+      ++stalls;
+      consumed_cv.wait(lock, [this] { return queue.size() < READBACK_MAX_QUEUED; });
+    }
+    if (!free_frames.empty()) {
+      frame = std::move(free_frames.back());
+      free_frames.pop_back();
+    }
+  }
+
+  const size_t size { static_cast<size_t>(width) * height * 4 };
+  frame.index  = frame_of[slot];
+  frame.width  = width;
+  frame.height = height;
+  frame.pixels.resize(size);
+
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, pbo[slot]);
+  const void* data { glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, static_cast<GLsizeiptr>(size), GL_MAP_READ_BIT) };
+  if (data) {
+    memcpy(frame.pixels.data(), data, size);
+    glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+  } else {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Could not map readback buffer for frame %d", frame.index);
+  }
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+  oldest = (oldest + 1) % READBACK_BUFFERS;
+  --pending;
+
+  if (!data) return;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    queue.push_back(std::move(frame));
+  }
+  queued_cv.notify_one();
+}
+
+void readback_t::consumer_loop() {
+  std::unique_lock<std::mutex> lock(mutex);
+  for (;;) {
+    queued_cv.wait(lock, [this] { return quit || !queue.empty(); });
+    if (queue.empty()) return; // quit once everything is consumed
+
+    readback_frame_t frame { std::move(queue.front()) };
+    queue.pop_front();
+    busy = true;
+
+    lock.unlock();
+    consumer(frame);
+    lock.lock();
+
+    busy = false;
+    free_frames.push_back(std::move(frame));
+    consumed_cv.notify_all();
+  }
+}
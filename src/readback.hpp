@@ -0,0 +1,61 @@
+#ifndef _READBACK_H_
+#define _READBACK_H_
+
+#include "main.hpp"
+#include "framebuffer.hpp"
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// frame N is copied into a pixel buffer while N+1 and N+2 render
+#define READBACK_BUFFERS 3
+// frames waiting for the consumer before capture() starts to wait for it
+#define READBACK_MAX_QUEUED 8
+
+// RGBA8, bottom row first
+struct readback_frame_t {
+  int                  index  { 0 };
+  int                  width  { 0 };
+  int                  height { 0 };
+  std::vector<uint8_t> pixels;
+};
+
+typedef std::function<void(const readback_frame_t&)> readback_consumer_t;
+
+struct readback_t {
+  GLuint                        pbo[READBACK_BUFFERS]      {};
+  GLsync                        fence[READBACK_BUFFERS]    {};
+  int                           frame_of[READBACK_BUFFERS] {};
+  int                           width   { 0 };
+  int                           height  { 0 };
+  int                           oldest  { 0 }; // next slot to retire
+  int                           pending { 0 }; // slots with a copy in flight
+  uint64_t                      stalls  { 0 }; // times the render thread had to wait
+
+  // frames are handed to the consumer on its own thread, in order
+  readback_consumer_t           consumer;
+  std::thread                   consumer_thread;
+  std::mutex                    mutex;
+  std::condition_variable       queued_cv;
+  std::condition_variable       consumed_cv;
+  std::deque<readback_frame_t>  queue;
+  std::vector<readback_frame_t> free_frames;
+  bool                          busy    { false };
+  bool                          quit    { false };
+
+  readback_t  (readback_consumer_t);
+  ~readback_t (void);
+
+  void capture       (framebuffer_t&, int); // starts the copy of a rendered frame
+  void poll          (void);                // retires copies that finished, never waits
+  void flush         (void);                // waits for every frame to reach the consumer
+
+  void retire        (bool);
+  void consumer_loop (void);
+};
+
+#endif // _READBACK_H_
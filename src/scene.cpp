@@ -0,0 +1,995 @@
+#include "scene.hpp"
+
+#include <algorithm>
+
+struct scene_parser_t {
+  const char* s;
+  const char* name;
+  int         line   { 1 };
+  bool        failed { false };
+  std::string dir    {};      // of the scene file, mesh files are relative to it
+};
+
+static void parse_error(scene_parser_t& ps, const char* what, const char* token, size_t len) {
+  if (ps.failed) return;
+  SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "%s:%d: %s `%.*s`", ps.name, ps.line, what,
+               static_cast<int>(len), token);
+  ps.failed = true;
+}
+
+// returns the next token, a parenthesis or an atom, length 0 at the end
+static const char* next_token(scene_parser_t& ps, size_t* len) {
+  for (;;) {
+    while (*ps.s == ' ' || *ps.s == '\t' || *ps.s == '\r' || *ps.s == '\n')
+      if (*ps.s++ == '\n') ++ps.line;
+    if (*ps.s != '#') break;
+    while (*ps.s && *ps.s != '\n') ++ps.s;
+  }
+
+  const char* token { ps.s };
+  if (*ps.s == '(' || *ps.s == ')') ++ps.s;
+  else while (*ps.s && !strchr(" \t\r\n()#", *ps.s)) ++ps.s;
+  *len = static_cast<size_t>(ps.s - token);
+  return token;
+}
+
+static scene_value_t parse_value(scene_parser_t& ps) {
+  size_t      len;
+  const char* token { next_token(ps, &len) };
+  const std::string atom { token, len };
+
+  scene_value_t v {};
+  const char*   num { atom.c_str() };
+  if (atom.size() >= 2 && atom[0] == '$' && strchr("xyzw", atom[1])) {
+    v.slider = static_cast<int>(strchr("xyzw", atom[1]) - "xyzw");
+    num += 2;
+    if (*num == '\0') return v;
+  }
+
+  char* end;
+  v.value = strtof(num, &end);
+  if (end == num || *end != '\0') parse_error(ps, "expected a number or $x $y $z $w, got", token, len);
+  return v;
+}
+
+// the file's volume, it goes into the scene's atlas once however many nodes use it
+static void parse_mesh(scene_t& scene, scene_parser_t& ps, scene_node_t& node) {
+  size_t      len;
+  const char* token { next_token(ps, &len) };
+  if (len == 0 || *token == '(' || *token == ')') {
+    parse_error(ps, "expected a mesh file, got", token, len);
+    return;
+  }
+  const std::string file { token, len };
+  const std::shared_ptr<const mesh_sdf_t> volume { load_mesh_sdf((file[0] == '/' ? file : ps.dir + file).c_str()) };
+  if (!volume) {
+    parse_error(ps, "could not load mesh", token, len);
+    return;
+  }
+
+  size_t slot { 0 };
+  while (slot < scene.meshes.size() && scene.meshes[slot] != volume) ++slot;
+  if (slot == scene.meshes.size()) {
+    if (slot == MESH_SDF_SLOTS) {
+      parse_error(ps, "the mesh atlas is full at", token, len);
+      return;
+    }
+    scene.meshes.push_back(volume);
+  }
+  node.mesh = static_cast<int>(slot);
+  const float v[6] { volume->lo.x, volume->lo.y, volume->lo.z, volume->cell, static_cast<float>(slot), MESH_SDF_SAMPLES };
+  for (int i = 0; i < 6; ++i) node.params[i].value = v[i];
+}
+
+static int parse_node(scene_t& scene, scene_parser_t& ps) {
+  size_t      len;
+  const char* token { next_token(ps, &len) };
+  if (len != 1 || *token != '(') {
+    parse_error(ps, len ? "expected `(`, got" : "unexpected end of scene", token, len);
+    return -1;
+  }
+
+  token = next_token(ps, &len);
+  int kind { -1 };
+  for (int k = 0; k < SCENE_KIND_COUNT; ++k)
+    if (strlen(scene_kinds[k].name) == len && strncmp(scene_kinds[k].name, token, len) == 0) kind = k;
+  if (kind < 0) {
+    parse_error(ps, "unknown node", token, len);
+    return -1;
+  }
+
+  scene_node_t node {};
+  node.kind = static_cast<scene_kind_t>(kind);
+  if (node.kind == SCENE_MESH) parse_mesh(scene, ps, node);
+  else for (int i = 0; i < scene_kinds[kind].params && !ps.failed; ++i)
+    node.params[i] = parse_value(ps);
+  for (int c = 0; c < scene_kinds[kind].children && !ps.failed; ++c)
+    node.children[c] = parse_node(scene, ps);
+  if (ps.failed) return -1;
+
+  token = next_token(ps, &len);
+  if (len != 1 || *token != ')') {
+    parse_error(ps, "expected `)`, got", token, len);
+    return -1;
+  }
+
+  // children come first, so every node only refers to lower indices
+  scene.nodes.push_back(node);
+  return static_cast<int>(scene.nodes.size()) - 1;
+}
+
+bool scene_t::parse(const char* src, const char* name) {
+  scene_parser_t ps { src, name };
+  scene_t        parsed {};
+  if (const char* slash = strrchr(name, '/')) ps.dir = std::string(name, slash + 1);
+  parsed.root = parse_node(parsed, ps);
+
+  size_t      len;
+  const char* token { next_token(ps, &len) };
+  if (!ps.failed && len) parse_error(ps, "trailing input", token, len);
+  if (ps.failed) return false;
+  // every parsed node is reachable, so the tape as written would have one instruction each
+  parsed.fold     = fold;
+  parsed.unfolded = static_cast<int>(parsed.nodes.size());
+  if (fold) parsed.fold_constants();
+  if (!parsed.compile(name)) return false;
+
+  *this = parsed;
+  return true;
+}
+
+bool scene_t::load(const char* path) {
+  if (get_last_modified_time(path) == 0) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Could not open scene `%s`", path);
+    return false;
+  }
+  size_t size { 0 };
+  char*  src  { slurp_file(path, &size) };
+  const bool ok { parse(src, path) };
+  free(static_cast<void*>(src));
+  return ok;
+}
+
+// glsl generation, one statement per node
+
+static std::string glsl_float(float v) {
+  char buf[32];
+  snprintf(buf, sizeof(buf), "%.9g", v); // enough digits to read back the same float
+  std::string s { buf };
+  if (s.find_first_of(".e") == std::string::npos) s += ".";
+  return s;
+}
+
+static std::string glsl_value(const scene_value_t& v) {
+  if (v.slider < 0) return glsl_float(v.value);
+  const std::string component { std::string("u_slider.") + "xyzw"[v.slider] };
+  if (v.value == 0.0f) return component;
+  return "(" + component + " + " + glsl_float(v.value) + ")";
+}
+
+static std::string glsl_vec3(const scene_value_t* v) {
+  return "vec3(" + glsl_value(v[0]) + ", " + glsl_value(v[1]) + ", " + glsl_value(v[2]) + ")";
+}
+
+// Rotate() of the node's angle, with its sin and cos folded in when it's constant and read from
+// u_rotate when it's a slider, so no pixel computes them
+static std::string glsl_rotate(const scene_t& scene, int index, const scene_value_t& angle) {
+  if (angle.slider < 0) return "Rotate(vec2(" + glsl_float(sin(angle.value)) + ", " + glsl_float(cos(angle.value)) + "))";
+  const size_t k { static_cast<size_t>(std::find(scene.rotations.begin(), scene.rotations.end(), index) - scene.rotations.begin()) };
+  if (k < SCENE_MAX_ROTATIONS) return "Rotate(u_rotate[" + std::to_string(k) + "])";
+  return "Rotate(" + glsl_value(angle) + ")";
+}
+
+// the gradient of the child's dual c, taken at the transformed point q = Rotate(a) p * s, in p.
+// rotate and scale are empty when the transform doesn't do them
+static std::string glsl_dual_back(const std::string& c, const std::string& rotate, const std::string& scale) {
+  std::string g { rotate.empty() ? c + ".yzw" : "vec3(" + rotate + " * " + c + ".yz, " + c + ".w)" };
+  if (!scale.empty()) g += " * " + scale;
+  return "vec4(" + c + ".x, " + g + ")";
+}
+
+// appends the statements for node evaluated at point p, returns the variable holding its distance.
+// dual makes that a vec4 of the distance and its gradient in p, see Sphere_dual() in fragment.glsl
+static std::string emit_glsl(const scene_t& scene, int index, const std::string& p, bool dual, std::string& out, int& next_var) {
+  const scene_node_t& n    { scene.nodes[index] };
+  const std::string   var  { std::to_string(next_var++) };
+  const std::string   d    { "d" + var };
+  const std::string   decl { (dual ? "  vec4 " : "  float ") + d + " = " };
+  const std::string   call { dual ? "_dual(" : "(" };
+
+  switch (n.kind) {
+  case SCENE_PLANE: {
+    const std::string dist { "dot(" + p + ", " + glsl_vec3(n.params) + ") + " + glsl_value(n.params[3]) };
+    out += decl + (dual ? "vec4(" + dist + ", " + glsl_vec3(n.params) + ")" : dist) + ";\n";
+    return d;
+  }
+  case SCENE_SPHERE:
+    out += decl + "Sphere" + call + p + ", " + glsl_value(n.params[0]) + ");\n";
+    return d;
+  case SCENE_CAPSULE:
+  case SCENE_CYLINDER:
+    out += decl + (n.kind == SCENE_CAPSULE ? "Capsule" : "Cylinder") + call + p + ", " +
+           glsl_vec3(n.params) + ", " + glsl_vec3(n.params + 3) + ", " + glsl_value(n.params[6]) + ");\n";
+    return d;
+  case SCENE_TORUS:
+    out += decl + "Torus" + call + p + ", vec2(" + glsl_value(n.params[0]) + ", " + glsl_value(n.params[1]) + "));\n";
+    return d;
+  case SCENE_BOX:
+    out += decl + "Box" + call + p + ", " + glsl_vec3(n.params) + ");\n";
+    return d;
+  case SCENE_MESH:
+    out += decl + "Mesh" + call + p + ", " + glsl_vec3(n.params) + ", " + glsl_value(n.params[3]) + ", " +
+           glsl_value(n.params[4]) + ", " + glsl_value(n.params[5]) + ");\n";
+    return d;
+
+  case SCENE_OR:
+  case SCENE_AND:
+  case SCENE_MINUS:
+  case SCENE_OR_SMOOTH: {
+    const std::string a { emit_glsl(scene, n.children[0], p, dual, out, next_var) };
+    const std::string b { emit_glsl(scene, n.children[1], p, dual, out, next_var) };
+    const char* op { n.kind == SCENE_OR ? "d_or(" : n.kind == SCENE_AND ? "d_and(" :
+                     n.kind == SCENE_MINUS ? "d_minus(" : "d_or_smooth(" };
+    out += decl + op + a + ", " + b +
+           (n.kind == SCENE_OR_SMOOTH ? ", " + glsl_value(n.params[0]) : std::string()) + ");\n";
+    return d;
+  }
+  case SCENE_LOD: { // only the child in use is evaluated, p is the scene's point
+    out += (dual ? "  vec4 " : "  float ") + d + ";\n";
+    out += "  if (length(p - u_camera_pos) < " + glsl_value(n.params[0]) + ") {\n";
+    const std::string a { emit_glsl(scene, n.children[0], p, dual, out, next_var) };
+    out += "  " + d + " = " + a + ";\n  } else {\n";
+    const std::string b { emit_glsl(scene, n.children[1], p, dual, out, next_var) };
+    out += "  " + d + " = " + b + ";\n  }\n";
+    return d;
+  }
+
+  case SCENE_TRANSLATE:
+    out += "  vec3 p" + var + " = " + p + " - " + glsl_vec3(n.params) + ";\n";
+    return emit_glsl(scene, n.children[0], "p" + var, dual, out, next_var);
+  case SCENE_SCALE: {
+    out += "  vec3 p" + var + " = " + p + " * " + glsl_value(n.params[0]) + ";\n";
+    const std::string c { emit_glsl(scene, n.children[0], "p" + var, dual, out, next_var) };
+    if (!dual) return c;
+    out += decl + glsl_dual_back(c, "", glsl_value(n.params[0])) + ";\n";
+    return d;
+  }
+  case SCENE_ROTATE: {
+    const std::string rotate { glsl_rotate(scene, index, n.params[0]) };
+    out += "  vec3 p" + var + " = " + p + ";\n";
+    out += "  p" + var + ".xy *= " + rotate + ";\n";
+    const std::string c { emit_glsl(scene, n.children[0], "p" + var, dual, out, next_var) };
+    if (!dual) return c;
+    out += decl + glsl_dual_back(c, rotate, "") + ";\n";
+    return d;
+  }
+  case SCENE_TRANSFORM: {
+    const std::string rotate { n.params[4].slider >= 0 || n.params[4].value != 0.0f ? glsl_rotate(scene, index, n.params[4]) : "" };
+    const std::string scale  { n.params[3].slider >= 0 || n.params[3].value != 1.0f ? glsl_value(n.params[3]) : "" };
+    out += "  vec3 p" + var + " = " + p + " - " + glsl_vec3(n.params) + ";\n";
+    if (!rotate.empty()) out += "  p" + var + ".xy *= " + rotate + ";\n";
+    if (!scale.empty())  out += "  p" + var + " *= " + scale + ";\n";
+    const std::string c { emit_glsl(scene, n.children[0], "p" + var, dual, out, next_var) };
+    if (!dual || (rotate.empty() && scale.empty())) return c;
+    out += decl + glsl_dual_back(c, rotate, scale) + ";\n";
+    return d;
+  }
+
+  default:
+    return d;
+  }
+}
+
+// the same for sdf_graph_bound(p, r): the node's d_bound() over the ball at p. every point
+// variable pN comes with rN, its ball's radius, and lN, how much it was scaled from the scene's
+static std::string emit_glsl_bound(const scene_t& scene, int index, const std::string& p, std::string& out, int& next_var) {
+  const scene_node_t& n   { scene.nodes[index] };
+  const std::string   r   { "r" + p.substr(1) };
+  const std::string   l   { "l" + p.substr(1) };
+
+  switch (scene_kinds[n.kind].children) {
+  case 0: {
+    const std::string dist { emit_glsl(scene, index, p, false, out, next_var) };
+    const std::string lipschitz { n.kind == SCENE_PLANE ? "length(" + glsl_vec3(n.params) + ")" :
+                                  n.kind == SCENE_MESH ? "1.7320508" : "1." };
+    const std::string d { "d" + std::to_string(next_var++) };
+    out += "  vec3 " + d + " = d_bound(" + dist + ", " + r + ", " + lipschitz + ", " + l + ");\n";
+    return d;
+  }
+  case 1:
+    break;
+  default: {
+    const std::string a { emit_glsl_bound(scene, n.children[0], p, out, next_var) };
+    const std::string b { emit_glsl_bound(scene, n.children[1], p, out, next_var) };
+    const std::string d { "d" + std::to_string(next_var++) };
+    if (n.kind == SCENE_LOD) {
+      out += "  vec3 " + d + " = d_lod(" + a + ", " + b + ", length(p - u_camera_pos), r, " + glsl_value(n.params[0]) + ");\n";
+      return d;
+    }
+    const char* op { n.kind == SCENE_OR ? "d_or(" : n.kind == SCENE_AND ? "d_and(" :
+                     n.kind == SCENE_MINUS ? "d_minus(" : "d_or_smooth(" };
+    out += "  vec3 " + d + " = " + op + a + ", " + b +
+           (n.kind == SCENE_OR_SMOOTH ? ", " + glsl_value(n.params[0]) : std::string()) + ");\n";
+    return d;
+  }
+  }
+
+  const std::string var { std::to_string(next_var++) };
+  std::string       scale;
+  switch (n.kind) {
+  case SCENE_TRANSLATE:
+    out += "  vec3 p" + var + " = " + p + " - " + glsl_vec3(n.params) + ";\n";
+    break;
+  case SCENE_SCALE:
+    scale = glsl_value(n.params[0]);
+    out += "  vec3 p" + var + " = " + p + " * " + scale + ";\n";
+    break;
+  case SCENE_ROTATE:
+    out += "  vec3 p" + var + " = " + p + ";\n";
+    out += "  p" + var + ".xy *= " + glsl_rotate(scene, index, n.params[0]) + ";\n";
+    break;
+  default:
+    if (n.params[3].slider >= 0 || n.params[3].value != 1.0f) scale = glsl_value(n.params[3]);
+    out += "  vec3 p" + var + " = " + p + " - " + glsl_vec3(n.params) + ";\n";
+    if (n.params[4].slider >= 0 || n.params[4].value != 0.0f)
+      out += "  p" + var + ".xy *= " + glsl_rotate(scene, index, n.params[4]) + ";\n";
+    if (!scale.empty()) out += "  p" + var + " *= " + scale + ";\n";
+    break;
+  }
+  const std::string factor { scale.empty() ? std::string() : " * abs(" + scale + ")" };
+  out += "  float r" + var + " = " + r + factor + ";\n";
+  out += "  float l" + var + " = " + l + factor + ";\n";
+  return emit_glsl_bound(scene, n.children[0], "p" + var, out, next_var);
+}
+
+std::string scene_t::glsl() const {
+  std::string src;
+  if (!rotations.empty())
+    src = "uniform vec2 u_rotate[" + std::to_string(glm::min(rotations.size(), static_cast<size_t>(SCENE_MAX_ROTATIONS))) + "];\n";
+  return src + glsl(root, "sdf_graph") + glsl(root, "sdf_graph_dual", true);
+}
+
+std::string scene_t::glsl(int node, const std::string& name, bool dual) const {
+  std::string body;
+  int         next_var { 0 };
+  const std::string d { node < 0 ? (dual ? "vec4(1e10, 0., 0., 0.)" : "1e10") : emit_glsl(*this, node, "p", dual, body, next_var) };
+  return (dual ? "vec4 " : "float ") + name + "(vec3 p) {\n" + body + "  return " + d + ";\n}\n";
+}
+
+std::string scene_t::glsl_bound() const {
+  std::string body;
+  int         next_var { 0 };
+  const std::string d { root < 0 ? "vec3(1e10, 1e10, 0.)" : emit_glsl_bound(*this, root, "p", body, next_var) };
+  return "vec3 sdf_graph_bound(vec3 p, float r) {\n  float l = 1.;\n" + body + "  return " + d + ";\n}\n";
+}
+
+std::string scene_segment_glsl() {
+  return "#define SDF_SEGMENT\n#define SEGMENT_GROWTH " + glsl_float(SCENE_SEGMENT_GROWTH) + "\n";
+}
+
+// constant folding on the tree, before the tape and the glsl are made from it
+
+// every transform kind is a case of p = Rotate(angle) (p - offset) * scale
+struct scene_xform_t {
+  vec3  offset { 0.0f };
+  float scale  { 1.0f };
+  float angle  { 0.0f };
+};
+
+static bool constant_params(const scene_node_t& n) {
+  for (int i = 0; i < scene_kinds[n.kind].params; ++i)
+    if (n.params[i].slider >= 0) return false;
+  return true;
+}
+
+static scene_xform_t node_xform(const scene_node_t& n) {
+  scene_xform_t x {};
+  switch (n.kind) {
+  case SCENE_TRANSLATE: x.offset = vec3(n.params[0].value, n.params[1].value, n.params[2].value); break;
+  case SCENE_SCALE:     x.scale  = n.params[0].value; break;
+  case SCENE_ROTATE:    x.angle  = n.params[0].value; break;
+  default:
+    x.offset = vec3(n.params[0].value, n.params[1].value, n.params[2].value);
+    x.scale  = n.params[3].value;
+    x.angle  = n.params[4].value;
+    break;
+  }
+  return x;
+}
+
+// p.xy turned the way Rotate(a) turns it
+static vec3 rotated(vec3 p, float a) {
+  const float s { sin(a) }, c { cos(a) };
+  return vec3(p.x*c - p.y*s, p.x*s + p.y*c, p.z);
+}
+
+static bool same_tree(const std::vector<scene_node_t>& nodes, int a, int b) {
+  if (a == b) return true;
+  const scene_node_t& x { nodes[a] };
+  const scene_node_t& y { nodes[b] };
+  if (x.kind != y.kind || x.mesh != y.mesh) return false;
+  for (int i = 0; i < scene_kinds[x.kind].params; ++i)
+    if (x.params[i].value != y.params[i].value || x.params[i].slider != y.params[i].slider) return false;
+  for (int c = 0; c < scene_kinds[x.kind].children; ++c)
+    if (!same_tree(nodes, x.children[c], y.children[c])) return false;
+  return true;
+}
+
+static int push_node(std::vector<scene_node_t>& out, const scene_node_t& n) {
+  out.push_back(n);
+  return static_cast<int>(out.size()) - 1;
+}
+
+// the cheapest kind that does x to child, the child itself for the identity
+static int push_xform(std::vector<scene_node_t>& out, const scene_xform_t& x, int child) {
+  const bool moved  { x.offset != vec3(0.0f) };
+  const bool scaled { x.scale != 1.0f };
+  const bool turned { x.angle != 0.0f };
+  if (!moved && !scaled && !turned) return child;
+
+  scene_node_t n {};
+  n.children[0] = child;
+  if (!scaled && !turned) {
+    n.kind = SCENE_TRANSLATE;
+    for (int i = 0; i < 3; ++i) n.params[i].value = x.offset[i];
+  } else if (!moved && !turned) {
+    n.kind = SCENE_SCALE;
+    n.params[0].value = x.scale;
+  } else if (!moved && !scaled) {
+    n.kind = SCENE_ROTATE;
+    n.params[0].value = x.angle;
+  } else {
+    n.kind = SCENE_TRANSFORM;
+    for (int i = 0; i < 3; ++i) n.params[i].value = x.offset[i];
+    n.params[3].value = x.scale;
+    n.params[4].value = x.angle;
+  }
+  return push_node(out, n);
+}
+
+// moves a rigid x into the params of a primitive that has its own position, false for the
+// ones that don't. p = Rotate(-angle) q + offset takes the child's points back to the parent's
+static bool absorb_xform(scene_node_t& prim, const scene_xform_t& x) {
+  if (x.scale != 1.0f || !constant_params(prim)) return false;
+  scene_value_t* v { prim.params };
+  switch (prim.kind) {
+  case SCENE_PLANE: { // dot(Rotate(a) (p - o), n) = dot(p - o, Rotate(-a) n)
+    const vec3 n { rotated(vec3(v[0].value, v[1].value, v[2].value), -x.angle) };
+    for (int i = 0; i < 3; ++i) v[i].value = n[i];
+    v[3].value -= dot(x.offset, n);
+    return true;
+  }
+  case SCENE_CAPSULE:
+  case SCENE_CYLINDER:
+    for (int e = 0; e < 6; e += 3) {
+      const vec3 end { rotated(vec3(v[e].value, v[e + 1].value, v[e + 2].value), -x.angle) + x.offset };
+      for (int i = 0; i < 3; ++i) v[e + i].value = end[i];
+    }
+    return true;
+  default:
+    return false;
+  }
+}
+
+// the node folded into out, children first. a constant transform's child was folded already,
+// so it merges with at most one transform below it
+static int fold_node(const scene_t& scene, int index, std::vector<scene_node_t>& out) {
+  scene_node_t n { scene.nodes[index] };
+  for (int c = 0; c < scene_kinds[n.kind].children; ++c) n.children[c] = fold_node(scene, n.children[c], out);
+
+  switch (scene_kinds[n.kind].children) {
+  case 0:
+    return push_node(out, n);
+  case 2:
+    if (n.kind == SCENE_OR_SMOOTH && constant_params(n) && n.params[0].value == 0.0f) n.kind = SCENE_OR;
+    if ((n.kind == SCENE_OR || n.kind == SCENE_AND || n.kind == SCENE_LOD) && same_tree(out, n.children[0], n.children[1]))
+      return n.children[0];
+    return push_node(out, n);
+  default:
+    break;
+  }
+  if (!constant_params(n)) return push_node(out, n);
+
+  // q = s2 Rotate(a2) (s Rotate(a) (p - o) - o2) = s s2 Rotate(a + a2) (p - o - Rotate(-a) o2 / s)
+  scene_xform_t x     { node_xform(n) };
+  int           child { n.children[0] };
+  if (scene_kinds[out[child].kind].children == 1 && constant_params(out[child]) && x.scale != 0.0f) {
+    const scene_xform_t y { node_xform(out[child]) };
+    x.offset += rotated(y.offset, -x.angle) / x.scale;
+    x.scale  *= y.scale;
+    x.angle  += y.angle;
+    child     = out[child].children[0];
+  }
+  if (out[child].kind == SCENE_SPHERE) x.angle = 0.0f; // turning it about its centre changes nothing
+
+  scene_node_t prim { out[child] };
+  if (scene_kinds[prim.kind].children == 0 && absorb_xform(prim, x)) return push_node(out, prim);
+  return push_xform(out, x, child);
+}
+
+// out gets the nodes reachable from index, children first like the parser leaves them
+static int compact_node(const std::vector<scene_node_t>& nodes, int index, std::vector<scene_node_t>& out) {
+  scene_node_t n { nodes[index] };
+  for (int c = 0; c < scene_kinds[n.kind].children; ++c) n.children[c] = compact_node(nodes, n.children[c], out);
+  return push_node(out, n);
+}
+
+void scene_t::fold_constants() {
+  if (root < 0) return;
+  std::vector<scene_node_t> folded, reachable;
+  const int folded_root { fold_node(*this, root, folded) };
+  root  = compact_node(folded, folded_root, reachable);
+  nodes = std::move(reachable);
+}
+
+// the tape, the same operations as the generated glsl. registers are given out Sethi-Ullman
+// style, the operand that needs more of them goes first, so long chains of unions only need two
+
+// scratch of one tape build, per node
+struct tape_builder_t {
+  const scene_t&              scene;
+  std::vector<scene_instr_t>& tape;
+  const float*                bound { nullptr }; // params per node, null leaves them to bind()
+  vec3                        centre { 0.0f };   // the ball prune() was given, in the scene's space
+  float                       radius { 0.0f };
+  std::vector<int>            regs;  // distance registers the subtree needs
+  std::vector<uint8_t>        keep;  // a bit per child that can change the node's distance
+  int                         num_regs   { 1 };
+  int                         num_points { 1 };
+
+  tape_builder_t(const scene_t& s, std::vector<scene_instr_t>& t) :
+    scene(s), tape(t), regs(s.nodes.size(), 1), keep(s.nodes.size(), 3) {}
+};
+
+static void count_regs(tape_builder_t& tb, int index) {
+  const scene_node_t& n { tb.scene.nodes[index] };
+  switch (scene_kinds[n.kind].children) {
+  case 0:
+    tb.regs[index] = 1;
+    break;
+  case 1:
+    count_regs(tb, n.children[0]);
+    tb.regs[index] = tb.regs[n.children[0]];
+    break;
+  default: {
+    for (int c = 0; c < 2; ++c)
+      if (tb.keep[index] & (1 << c)) count_regs(tb, n.children[c]);
+    if (tb.keep[index] != 3) { // only one child is left, the node just passes its distance on
+      tb.regs[index] = tb.regs[n.children[tb.keep[index] >> 1]];
+      break;
+    }
+    const int a { tb.regs[n.children[0]] };
+    const int b { tb.regs[n.children[1]] };
+    tb.regs[index] = a == b ? a + 1 : glm::max(a, b);
+  }
+  }
+}
+
+// appends node evaluated at point register point, its distance ends up in register out
+static void emit_tape(tape_builder_t& tb, int index, int point, int out) {
+  const scene_node_t& n { tb.scene.nodes[index] };
+  scene_instr_t in {};
+  in.kind = n.kind;
+  in.node = index;
+  in.out  = out;
+  in.a    = point;
+  if (n.kind == SCENE_MESH) in.mesh = tb.scene.meshes[n.mesh].get();
+  if (tb.bound)
+    for (int i = 0; i < SCENE_MAX_PARAMS; ++i) in.v[i] = tb.bound[index * SCENE_MAX_PARAMS + i];
+  tb.num_regs   = glm::max(tb.num_regs, out + 1);
+  tb.num_points = glm::max(tb.num_points, point + 1);
+
+  switch (scene_kinds[n.kind].children) {
+  case 0:
+    break;
+  case 1: // transforms hand their subtree a new point register
+    in.out = point + 1;
+    tb.tape.push_back(in);
+    emit_tape(tb, n.children[0], point + 1, out);
+    return;
+  default: {
+    if (tb.keep[index] != 3) {
+      emit_tape(tb, n.children[tb.keep[index] >> 1], point, out);
+      return;
+    }
+    const bool a_first { tb.regs[n.children[0]] >= tb.regs[n.children[1]] };
+    emit_tape(tb, n.children[a_first ? 0 : 1], point, out);
+    emit_tape(tb, n.children[a_first ? 1 : 0], point, out + 1);
+    in.a = a_first ? out : out + 1;
+    in.b = a_first ? out + 1 : out;
+    break;
+  }
+  }
+  tb.tape.push_back(in);
+}
+
+bool scene_t::compile(const char* name) {
+  tape.clear();
+  tape_builder_t tb { *this, tape };
+  if (root >= 0) {
+    count_regs(tb, root);
+    emit_tape(tb, root, 0, 0);
+  }
+  num_regs   = tb.num_regs;
+  num_points = tb.num_points;
+  rotations.clear();
+  for (size_t i = 0; i < nodes.size(); ++i)
+    if ((nodes[i].kind == SCENE_ROTATE && nodes[i].params[0].slider >= 0) ||
+        (nodes[i].kind == SCENE_TRANSFORM && nodes[i].params[4].slider >= 0))
+      rotations.push_back(static_cast<int>(i));
+  if (num_regs > SCENE_MAX_REGS || num_points > SCENE_MAX_REGS) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "%s: scene needs %d distance and %d point registers, at most %d",
+                 name, num_regs, num_points, SCENE_MAX_REGS);
+    return false;
+  }
+  return true;
+}
+
+static void bind_instr(const scene_node_t& n, const vec4& slider, float* v) {
+  for (int i = 0; i < scene_kinds[n.kind].params; ++i)
+    v[i] = n.params[i].slider < 0 ? n.params[i].value : slider[n.params[i].slider] + n.params[i].value;
+  if (n.kind == SCENE_ROTATE) { // the same sin and cos Rotate() computes
+    v[1] = sin(v[0]);
+    v[2] = cos(v[0]);
+  }
+  if (n.kind == SCENE_TRANSFORM) {
+    v[5] = sin(v[4]);
+    v[6] = cos(v[4]);
+  }
+}
+
+void scene_t::bind(const vec4& slider, const vec3* eye) {
+  bound.assign(nodes.size() * SCENE_MAX_PARAMS, 0.0f);
+  for (size_t i = 0; i < nodes.size(); ++i) {
+    float* v { &bound[i * SCENE_MAX_PARAMS] };
+    bind_instr(nodes[i], slider, v);
+    if (nodes[i].kind != SCENE_LOD) continue;
+    if (!eye) v[0] = INFINITY;
+    else for (int k = 0; k < 3; ++k) v[1 + k] = (*eye)[k];
+  }
+  for (scene_instr_t& in : tape)
+    for (int i = 0; i < SCENE_MAX_PARAMS; ++i) in.v[i] = bound[in.node * SCENE_MAX_PARAMS + i];
+}
+
+void scene_t::bind_rotations(const vec4& slider, std::vector<float>& values) const {
+  values.clear();
+  for (size_t k = 0; k < rotations.size() && k < SCENE_MAX_ROTATIONS; ++k) {
+    const scene_node_t& n { nodes[rotations[k]] };
+    float v[SCENE_MAX_PARAMS] {};
+    bind_instr(n, slider, v);
+    values.push_back(n.kind == SCENE_ROTATE ? v[1] : v[5]);
+    values.push_back(n.kind == SCENE_ROTATE ? v[2] : v[6]);
+  }
+}
+
+static float eval_primitive(int kind, const float* v, vec3 q) {
+  switch (kind) {
+  case SCENE_PLANE:    return dot(q, vec3(v[0], v[1], v[2])) + v[3];
+  case SCENE_SPHERE:   return Sphere(q, v[0]);
+  case SCENE_CAPSULE:  return Capsule(q, vec3(v[0], v[1], v[2]), vec3(v[3], v[4], v[5]), v[6]);
+  case SCENE_CYLINDER: return Cylinder(q, vec3(v[0], v[1], v[2]), vec3(v[3], v[4], v[5]), v[6]);
+  case SCENE_TORUS:    return Torus(q, vec2(v[0], v[1]));
+  case SCENE_BOX:      return Box(q, vec3(v[0], v[1], v[2]));
+  }
+  return 1e10f;
+}
+
+// how far a primitive's distance can change per unit its point moves, 1 for all of them but
+// planes with a longer normal and meshes, whose trilinear samples can change by a cell along
+// each axis across a cell
+static float primitive_lipschitz(int kind, const float* v) {
+  return kind == SCENE_PLANE ? length(vec3(v[0], v[1], v[2])) : kind == SCENE_MESH ? 1.7320508f : 1.0f;
+}
+
+// bounds of the node's distance over the ball (c, r), and which children of its operators
+// can decide the distance somewhere in it. primitives change by at most their Lipschitz
+// constant times the distance moved
+static vec2 prune_node(tape_builder_t& tb, int index, vec3 c, float r) {
+  const scene_node_t& n { tb.scene.nodes[index] };
+  const float*        v { tb.bound + index * SCENE_MAX_PARAMS };
+
+  switch (scene_kinds[n.kind].children) {
+  case 0: {
+    const float d { n.kind == SCENE_MESH ? tb.scene.meshes[n.mesh]->eval(c) : eval_primitive(n.kind, v, c) };
+    // d_bound leaves a little extra so rounding never lets a branch go that could still win
+    return vec2(d_bound(d, r, primitive_lipschitz(n.kind, v), 1.0f));
+  }
+  case 1:
+    switch (n.kind) {
+    case SCENE_TRANSLATE: return prune_node(tb, n.children[0], c - vec3(v[0], v[1], v[2]), r);
+    case SCENE_SCALE:     return prune_node(tb, n.children[0], c * v[0], r * abs(v[0]));
+    case SCENE_ROTATE:    return prune_node(tb, n.children[0], vec3(c.x*v[2] - c.y*v[1], c.x*v[1] + c.y*v[2], c.z), r);
+    default: {
+      const vec3 t { c - vec3(v[0], v[1], v[2]) };
+      return prune_node(tb, n.children[0], vec3(t.x*v[6] - t.y*v[5], t.x*v[5] + t.y*v[6], t.z) * v[3], r * abs(v[3]));
+    }
+    }
+  default: break;
+  }
+
+  const vec2 a { prune_node(tb, n.children[0], c, r) };
+  const vec2 b { prune_node(tb, n.children[1], c, r) };
+  uint8_t& keep { tb.keep[index] };
+  switch (n.kind) {
+  case SCENE_OR:
+    keep = a.x > b.y ? 2 : b.x > a.y ? 1 : 3;
+    return vec2(glm::min(a.x, b.x), glm::min(a.y, b.y));
+  case SCENE_AND:
+    keep = a.y < b.x ? 2 : b.y < a.x ? 1 : 3;
+    return vec2(glm::max(a.x, b.x), glm::max(a.y, b.y));
+  case SCENE_MINUS: // max(-b, a) of the children, only the cut can be left out without a negation
+    keep = -b.x < a.x ? 1 : 3;
+    return vec2(glm::max(-b.y, a.x), glm::max(-b.x, a.y));
+  case SCENE_LOD: { // the camera's distance is the whole ball's, not the transformed one's
+    const float t { length(tb.centre - vec3(v[1], v[2], v[3])) };
+    keep = t + tb.radius < v[0] ? 1 : t - tb.radius >= v[0] ? 2 : 3;
+    return vec2(glm::min(a.x, b.x), glm::max(a.y, b.y));
+  }
+  default: {        // or-smooth, h is 0 or 1 when the distances are at least k apart
+    const float k { v[0] };
+    keep = a.x - b.y >= k ? 2 : b.x - a.y >= k ? 1 : 3;
+    return vec2(glm::min(a.x, b.x) - 0.25f * abs(k), glm::min(a.y, b.y));
+  }
+  }
+}
+
+void scene_t::prune(vec3 c, float r, std::vector<scene_instr_t>& out) const {
+  out.clear();
+  if (root < 0) return;
+  tape_builder_t tb { *this, out };
+  tb.bound  = bound.data();
+  tb.centre = c;
+  tb.radius = r;
+  prune_node(tb, root, c, r);
+  count_regs(tb, root);
+  emit_tape(tb, root, 0, 0);
+}
+
+void scene_t::prune(int node, std::vector<scene_instr_t>& out) const {
+  out.clear();
+  tape_builder_t tb { *this, out };
+  tb.bound = bound.data();
+  count_regs(tb, node);
+  emit_tape(tb, node, 0, 0);
+}
+
+static void prune_lod_node(tape_builder_t& tb, int index, float t0, float t1) {
+  const scene_node_t& n { tb.scene.nodes[index] };
+  for (int c = 0; c < scene_kinds[n.kind].children; ++c) prune_lod_node(tb, n.children[c], t0, t1);
+  if (n.kind != SCENE_LOD) return;
+  const float far { tb.bound[index * SCENE_MAX_PARAMS] };
+  tb.keep[index] = t1 <= far ? 1 : t0 >= far ? 2 : 3;
+}
+
+void scene_t::prune_lod(float t0, float t1, std::vector<scene_instr_t>& out) const {
+  out.clear();
+  if (root < 0) return;
+  tape_builder_t tb { *this, out };
+  tb.bound = bound.data();
+  prune_lod_node(tb, root, t0, t1);
+  count_regs(tb, root);
+  emit_tape(tb, root, 0, 0);
+}
+
+void scene_t::mesh_atlas(ivec3& size, std::vector<float>& texels) const {
+  // slots fill x first like the brick atlas, fragment.glsl finds them from the texture's size
+  constexpr int n         { MESH_SDF_SAMPLES };
+  constexpr int max_slots { MESH_SDF_ATLAS / MESH_SDF_SAMPLES };
+  const int     count     { static_cast<int>(meshes.size()) };
+  ivec3 slots;
+  slots.x = glm::max(1, glm::min(max_slots, count));
+  slots.y = glm::max(1, glm::min(max_slots, (count + slots.x - 1) / slots.x));
+  slots.z = glm::max(1, (count + slots.x * slots.y - 1) / (slots.x * slots.y));
+  size = slots * n;
+  texels.assign(static_cast<size_t>(size.x) * size.y * size.z, 0.0f);
+  for (int m = 0; m < count; ++m) {
+    const ivec3 base { ivec3(m % slots.x, (m / slots.x) % slots.y, m / (slots.x * slots.y)) * n };
+    for (int z = 0; z < n; ++z)
+      for (int y = 0; y < n; ++y)
+        memcpy(&texels[(static_cast<size_t>(base.z + z) * size.y + base.y + y) * size.x + base.x],
+               &meshes[m]->samples[(static_cast<size_t>(z) * n + y) * n], n * sizeof(float));
+  }
+}
+
+void scene_t::pack_tape(const vec4& slider, std::vector<float>& texels) const {
+  texels.assign(tape.size() * SCENE_TAPE_STRIDE * 4, 0.0f);
+  for (size_t i = 0; i < tape.size(); ++i) {
+    float* t { &texels[i * SCENE_TAPE_STRIDE * 4] };
+    t[0] = static_cast<float>(tape[i].kind);
+    t[1] = static_cast<float>(tape[i].out);
+    t[2] = static_cast<float>(tape[i].a);
+    t[3] = static_cast<float>(tape[i].b);
+    bind_instr(nodes[tape[i].node], slider, t + 4);
+  }
+}
+
+std::string scene_tape_glsl() {
+  std::string defines { "#define SDF_TAPE\n"
+                        "#define TAPE_REGS "   + std::to_string(SCENE_MAX_REGS) + "\n"
+                        "#define TAPE_LENGTH " + std::to_string(SCENE_MAX_TAPE) + "\n" };
+  for (int k = 0; k < SCENE_KIND_COUNT; ++k) {
+    std::string name { scene_kinds[k].name };
+    for (char& c : name) c = (c == '-') ? '_' : static_cast<char>(toupper(c));
+    defines += "#define OP_" + name + " " + std::to_string(k) + "\n";
+  }
+  return defines;
+}
+
+float eval_tape(const std::vector<scene_instr_t>& tape, vec3 p) {
+  vec3  q[SCENE_MAX_REGS];
+  float d[SCENE_MAX_REGS];
+  q[0] = p;
+  d[0] = 1e10f;
+
+  for (const scene_instr_t& in : tape) {
+    const float* v { in.v };
+    switch (in.kind) {
+    case SCENE_OR:        d[in.out] = d_or(d[in.a], d[in.b]); break;
+    case SCENE_AND:       d[in.out] = d_and(d[in.a], d[in.b]); break;
+    case SCENE_MINUS:     d[in.out] = d_minus(d[in.a], d[in.b]); break;
+    case SCENE_OR_SMOOTH: d[in.out] = d_or_smooth(d[in.a], d[in.b], v[0]); break;
+    case SCENE_LOD:       d[in.out] = d_lod(d[in.a], d[in.b], length(p - vec3(v[1], v[2], v[3])), v[0]); break;
+
+    case SCENE_TRANSLATE: q[in.out] = q[in.a] - vec3(v[0], v[1], v[2]); break;
+    case SCENE_SCALE:     q[in.out] = q[in.a] * v[0]; break;
+    case SCENE_ROTATE:    q[in.out] = vec3(q[in.a].x*v[2] - q[in.a].y*v[1], q[in.a].x*v[1] + q[in.a].y*v[2], q[in.a].z); break;
+    case SCENE_TRANSFORM: {
+      const vec3 t { q[in.a] - vec3(v[0], v[1], v[2]) };
+      q[in.out] = vec3(t.x*v[6] - t.y*v[5], t.x*v[5] + t.y*v[6], t.z) * v[3];
+    } break;
+    case SCENE_MESH:      d[in.out] = in.mesh->eval(q[in.a]); break;
+    default:              d[in.out] = eval_primitive(in.kind, v, q[in.a]); break;
+    }
+  }
+  return d[0];
+}
+
+float scene_t::eval(vec3 p) const {
+  return eval_tape(tape, p);
+}
+
+// the gradient of a primitive's dual at q, back in the tape's point p through dq/dp
+static vec4 dual_chain(vec4 e, const mat3& j) {
+  return vec4(e.x, vec3(e.y, e.z, e.w) * j);
+}
+
+static vec4 eval_primitive_dual(int kind, const float* v, vec3 q) {
+  switch (kind) {
+  case SCENE_PLANE:    return vec4(dot(q, vec3(v[0], v[1], v[2])) + v[3], v[0], v[1], v[2]);
+  case SCENE_SPHERE:   return Sphere_dual(q, v[0]);
+  case SCENE_CAPSULE:  return Capsule_dual(q, vec3(v[0], v[1], v[2]), vec3(v[3], v[4], v[5]), v[6]);
+  case SCENE_CYLINDER: return Cylinder_dual(q, vec3(v[0], v[1], v[2]), vec3(v[3], v[4], v[5]), v[6]);
+  case SCENE_TORUS:    return Torus_dual(q, vec2(v[0], v[1]));
+  case SCENE_BOX:      return Box_dual(q, vec3(v[0], v[1], v[2]));
+  }
+  return vec4(1e10f, 0.0f, 0.0f, 0.0f);
+}
+
+// like sdf_graph_dual() in fragment.glsl, the point registers keep their jacobian in p
+vec4 eval_tape_dual(const std::vector<scene_instr_t>& tape, vec3 p) {
+  vec3 q[SCENE_MAX_REGS];
+  mat3 j[SCENE_MAX_REGS];
+  vec4 d[SCENE_MAX_REGS];
+  q[0] = p;
+  j[0] = mat3(1.0f);
+  d[0] = vec4(1e10f, 0.0f, 0.0f, 0.0f);
+
+  for (const scene_instr_t& in : tape) {
+    const float* v { in.v };
+    switch (in.kind) {
+    case SCENE_OR:        d[in.out] = d_or(d[in.a], d[in.b]); break;
+    case SCENE_AND:       d[in.out] = d_and(d[in.a], d[in.b]); break;
+    case SCENE_MINUS:     d[in.out] = d_minus(d[in.a], d[in.b]); break;
+    case SCENE_OR_SMOOTH: d[in.out] = d_or_smooth(d[in.a], d[in.b], v[0]); break;
+    case SCENE_LOD:       d[in.out] = d_lod(d[in.a], d[in.b], length(p - vec3(v[1], v[2], v[3])), v[0]); break;
+
+    case SCENE_TRANSLATE:
+      q[in.out] = q[in.a] - vec3(v[0], v[1], v[2]);
+      j[in.out] = j[in.a];
+      break;
+    case SCENE_SCALE:
+      q[in.out] = q[in.a] * v[0];
+      j[in.out] = j[in.a] * v[0];
+      break;
+    case SCENE_ROTATE:
+      q[in.out] = vec3(q[in.a].x*v[2] - q[in.a].y*v[1], q[in.a].x*v[1] + q[in.a].y*v[2], q[in.a].z);
+      j[in.out] = mat3(v[2], v[1], 0.0f, -v[1], v[2], 0.0f, 0.0f, 0.0f, 1.0f) * j[in.a];
+      break;
+    case SCENE_TRANSFORM: {
+      const vec3 t { q[in.a] - vec3(v[0], v[1], v[2]) };
+      q[in.out] = vec3(t.x*v[6] - t.y*v[5], t.x*v[5] + t.y*v[6], t.z) * v[3];
+      j[in.out] = mat3(v[6], v[5], 0.0f, -v[5], v[6], 0.0f, 0.0f, 0.0f, 1.0f) * j[in.a] * v[3];
+    } break;
+    case SCENE_MESH:      d[in.out] = dual_chain(in.mesh->eval_dual(q[in.a]), j[in.a]); break;
+    default:              d[in.out] = dual_chain(eval_primitive_dual(in.kind, v, q[in.a]), j[in.a]); break;
+    }
+  }
+  return d[0];
+}
+
+vec4 scene_t::eval_dual(vec3 p) const {
+  return eval_tape_dual(tape, p);
+}
+
+// like sdf_graph_bound() in fragment.glsl, s keeps each point register's radius and scale
+vec3 eval_tape_bound(const std::vector<scene_instr_t>& tape, vec3 p, float radius) {
+  vec3 q[SCENE_MAX_REGS];
+  vec2 s[SCENE_MAX_REGS];
+  vec3 d[SCENE_MAX_REGS];
+  q[0] = p;
+  s[0] = vec2(radius, 1.0f);
+  d[0] = vec3(1e10f, 1e10f, 0.0f);
+
+  for (const scene_instr_t& in : tape) {
+    const float* v { in.v };
+    const vec2   e { s[in.a] };
+    switch (in.kind) {
+    case SCENE_OR:        d[in.out] = d_or(d[in.a], d[in.b]); break;
+    case SCENE_AND:       d[in.out] = d_and(d[in.a], d[in.b]); break;
+    case SCENE_MINUS:     d[in.out] = d_minus(d[in.a], d[in.b]); break;
+    case SCENE_OR_SMOOTH: d[in.out] = d_or_smooth(d[in.a], d[in.b], v[0]); break;
+    case SCENE_LOD:       d[in.out] = d_lod(d[in.a], d[in.b], length(p - vec3(v[1], v[2], v[3])), radius, v[0]); break;
+
+    case SCENE_TRANSLATE: q[in.out] = q[in.a] - vec3(v[0], v[1], v[2]); s[in.out] = e; break;
+    case SCENE_SCALE:     q[in.out] = q[in.a] * v[0]; s[in.out] = e * abs(v[0]); break;
+    case SCENE_ROTATE:
+      q[in.out] = vec3(q[in.a].x*v[2] - q[in.a].y*v[1], q[in.a].x*v[1] + q[in.a].y*v[2], q[in.a].z);
+      s[in.out] = e;
+      break;
+    case SCENE_TRANSFORM: {
+      const vec3 t { q[in.a] - vec3(v[0], v[1], v[2]) };
+      q[in.out] = vec3(t.x*v[6] - t.y*v[5], t.x*v[5] + t.y*v[6], t.z) * v[3];
+      s[in.out] = e * abs(v[3]);
+    } break;
+    case SCENE_MESH:      d[in.out] = d_bound(in.mesh->eval(q[in.a]), e.x, primitive_lipschitz(in.kind, v), e.y); break;
+    default:              d[in.out] = d_bound(eval_primitive(in.kind, v, q[in.a]), e.x, primitive_lipschitz(in.kind, v), e.y); break;
+    }
+  }
+  return d[0];
+}
+
+vec3 scene_t::eval_bound(vec3 p, float radius) const {
+  return eval_tape_bound(tape, p, radius);
+}
+
+vfloat eval_tape(const std::vector<scene_instr_t>& tape, const vvec3& p) {
+  vvec3  q[SCENE_MAX_REGS];
+  vfloat d[SCENE_MAX_REGS];
+  q[0] = p;
+  d[0] = 1e10f;
+
+  for (const scene_instr_t& in : tape) {
+    const float* v { in.v };
+    switch (in.kind) {
+    case SCENE_PLANE:     d[in.out] = q[in.a].x*v[0] + q[in.a].y*v[1] + q[in.a].z*v[2] + v[3]; break;
+    case SCENE_SPHERE:    d[in.out] = Sphere(q[in.a], v[0]); break;
+    case SCENE_CAPSULE:   d[in.out] = Capsule(q[in.a], vec3(v[0], v[1], v[2]), vec3(v[3], v[4], v[5]), v[6]); break;
+    case SCENE_CYLINDER:  d[in.out] = Cylinder(q[in.a], vec3(v[0], v[1], v[2]), vec3(v[3], v[4], v[5]), v[6]); break;
+    case SCENE_TORUS:     d[in.out] = Torus(q[in.a], vec2(v[0], v[1])); break;
+    case SCENE_BOX:       d[in.out] = Box(q[in.a], vec3(v[0], v[1], v[2])); break;
+    case SCENE_MESH:      d[in.out] = in.mesh->eval(q[in.a]); break;
+
+    case SCENE_OR:        d[in.out] = d_or(d[in.a], d[in.b]); break;
+    case SCENE_AND:       d[in.out] = d_and(d[in.a], d[in.b]); break;
+    case SCENE_MINUS:     d[in.out] = d_minus(d[in.a], d[in.b]); break;
+    case SCENE_OR_SMOOTH: d[in.out] = d_or_smooth(d[in.a], d[in.b], v[0]); break;
+    case SCENE_LOD:       d[in.out] = d_lod(d[in.a], d[in.b], vlength(p - vvec3(vec3(v[1], v[2], v[3]))), v[0]); break;
+
+    case SCENE_TRANSLATE: q[in.out] = q[in.a] - vec3(v[0], v[1], v[2]); break;
+    case SCENE_SCALE:     q[in.out] = q[in.a] * v[0]; break;
+    case SCENE_ROTATE: {
+      const vvec3& r { q[in.a] };
+      q[in.out] = vvec3(r.x*v[2] - r.y*v[1], r.x*v[1] + r.y*v[2], r.z);
+    } break;
+    case SCENE_TRANSFORM: {
+      const vvec3 t { q[in.a] - vvec3(vec3(v[0], v[1], v[2])) };
+      q[in.out] = vvec3(t.x*v[6] - t.y*v[5], t.x*v[5] + t.y*v[6], t.z) * v[3];
+    } break;
+    }
+  }
+  return d[0];
+}
+
+vfloat scene_t::eval(const vvec3& p) const {
+  return eval_tape(tape, p);
+}
@@ -0,0 +1,184 @@
+#ifndef _SCENE_H_
+#define _SCENE_H_
+
+#include "main.hpp"
+#include "sdf.hpp"
+#include "mesh_sdf.hpp"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+// the CSG tree both backends render: shader_t gets it as generated GLSL,
+// cpu_renderer_t interprets its tape (scene_instr_t), which fragment.glsl can interpret too
+enum scene_kind_t {
+  // primitives, evaluated at the point their parent transforms hand down
+  SCENE_PLANE = 0,
+  SCENE_SPHERE,
+  SCENE_CAPSULE,
+  SCENE_CYLINDER,
+  SCENE_TORUS,
+  SCENE_BOX,
+  SCENE_MESH,      // a triangle mesh's sampled distance, mesh_sdf_t
+  // operators on two distances
+  SCENE_OR,
+  SCENE_AND,
+  SCENE_MINUS,     // first child minus the second, d_minus(first, second)
+  SCENE_OR_SMOOTH,
+  SCENE_LOD,       // the first child near the camera, the second, a cheaper one inside it, further out
+  // transforms of the point for one child, scale doesn't correct the distance (p *= s)
+  SCENE_TRANSLATE,
+  SCENE_SCALE,
+  SCENE_ROTATE,    // p.xy *= Rotate(a)
+  SCENE_TRANSFORM, // the three at once, p = Rotate(a) (p - offset) * s, what fold() merges chains into
+  SCENE_KIND_COUNT
+};
+
+struct scene_kind_info_t {
+  const char* name;
+  int         params;
+  int         children;
+};
+
+#define SCENE_MAX_PARAMS 7
+
+constexpr scene_kind_info_t scene_kinds[SCENE_KIND_COUNT] {
+  { "plane",     4, 0 }, // normal xyz, offset: dot(p, n) + h
+  { "sphere",    1, 0 }, // radius
+  { "capsule",   7, 0 }, // a xyz, b xyz, radius
+  { "cylinder",  7, 0 }, // a xyz, b xyz, radius
+  { "torus",     2, 0 }, // major, minor radius
+  { "box",       3, 0 }, // half size xyz
+  { "mesh",      6, 0 }, // a file name, the params come from its volume: lo xyz, cell, atlas slot, samples
+  { "or",        0, 2 },
+  { "and",       0, 2 },
+  { "minus",     0, 2 },
+  { "or-smooth", 1, 2 }, // k
+  { "lod",       1, 2 }, // distance it switches at, bind() puts the camera in v[1..3]
+  { "translate", 3, 1 }, // offset xyz, p -= offset
+  { "scale",     1, 1 }, // factor
+  { "rotate",    1, 1 }, // angle
+  { "transform", 5, 1 }, // offset xyz, scale, angle
+};
+
+// a constant, or a u_slider component plus a constant
+struct scene_value_t {
+  float value  { 0.0f };
+  int   slider { -1   }; // 0..3 for x..w
+};
+
+struct scene_node_t {
+  scene_kind_t  kind     { SCENE_SPHERE };
+  scene_value_t params[SCENE_MAX_PARAMS] {};
+  int           children[2] { -1, -1 };
+  int           mesh        { -1 };     // index into scene_t::meshes
+};
+
+// distance and point registers of a tape, the GLSL interpreter declares arrays this big
+#define SCENE_MAX_REGS 16
+// vec4s per instruction in the GLSL tape: (kind, out, a, b), v[0..3], v[4..6]
+#define SCENE_TAPE_STRIDE 3
+// instructions the GLSL tape holds, 12KiB of uniform block where GL 3.3 guarantees 16KiB
+#define SCENE_MAX_TAPE 256
+// rotations by a slider whose sin and cos the generated GLSL reads from u_rotate, the CPU
+// computes them when the sliders move. any more compute their own
+#define SCENE_MAX_ROTATIONS 16
+
+// one instruction of the tape both backends interpret. primitives write distance register out
+// from point register a, operators combine distance registers a and b, transforms write point
+// register out from point register a. v holds the params with the sliders applied, rotate keeps
+// its sin and cos in v[1] and v[2], transform in v[5] and v[6]
+struct scene_instr_t {
+  int   kind { SCENE_OR };
+  int   out  { 0 };
+  int   a    { 0 };
+  int   b    { 0 };
+  int   node { -1 };
+  float v[SCENE_MAX_PARAMS] {};
+  const mesh_sdf_t* mesh { nullptr }; // the volume mesh primitives sample on the cpu
+};
+
+// scene files are s-expressions of the kinds above, params first then children, '#' comments:
+//   (minus (box 1 1 1) (translate 0 $y+1 0 (sphere 1.2)))
+// $x $y $z $w read the sliders, with an optional constant added. meshes name an OBJ or PLY file
+// relative to the scene file, (mesh bunny.ply), and are baked to a volume when the scene loads.
+// (lod 40 (detailed ...) (simple ...)) switches to the simple subtree 40 from the camera
+struct scene_t {
+  std::vector<scene_node_t>  nodes;
+  std::vector<std::shared_ptr<const mesh_sdf_t>> meshes; // in atlas slot order, each file once
+  int                        root      { -1 };
+  std::vector<scene_instr_t> tape;
+  int                        num_regs  { 1 }; // distance registers the tape uses
+  int                        num_points{ 1 }; // point registers
+  std::vector<float>         bound;           // SCENE_MAX_PARAMS per node as bind() applied them
+  std::vector<int>           rotations;       // rotate and transform nodes whose angle is a slider
+  bool                       fold      { true }; // parse() folds constants, false compiles the tree as written
+  int                        unfolded  { 0 }; // tape instructions before folding
+
+  bool        parse (const char*, const char*); // source, name used in errors
+  bool        load  (const char*);
+  std::string glsl  (void) const; // defines float sdf_graph(vec3 p) and vec4 sdf_graph_dual(vec3 p)
+  // float name(vec3 p) for one node's subtree, or with dual vec4 name(vec3 p) of its distance and gradient
+  std::string glsl  (int, const std::string&, bool = false) const;
+  // vec3 sdf_graph_bound(vec3 p, float r): d_bound() of the distance over the ball, for segment tracing
+  std::string glsl_bound (void) const;
+  void        mesh_atlas (ivec3&, std::vector<float>&) const; // the volumes for fragment.glsl's u_meshes, and its size
+
+  // merges chains of constant transforms into one, moves rigid ones into the params of planes,
+  // capsules and cylinders, drops identities and duplicate union branches. the distance is
+  // the same up to rounding
+  void        fold_constants (void);
+  bool        compile (const char*); // builds tape, false when it needs too many registers
+
+  // the cpu evaluates bound copies, bind once per frame so eval needn't look at the sliders.
+  // lod nodes measure from the camera position given, without one they keep their first child
+  void        bind  (const vec4&, const vec3* = nullptr);
+  void        bind_rotations (const vec4&, std::vector<float>&) const; // sin, cos per rotations entry for u_rotate
+  float       eval  (vec3) const;
+  vfloat      eval  (const vvec3&) const;
+  vec4        eval_dual (vec3) const; // the distance and its gradient, for normals
+  // bounds of the distance over a ball and in z its Lipschitz bound there, like d_bound()
+  vec3        eval_bound (vec3, float) const;
+
+  // the tape without the branches that can't decide the distance anywhere in the ball,
+  // by interval arithmetic over the tree like libfive does for its regions. needs bind() first
+  void        prune (vec3, float, std::vector<scene_instr_t>&) const;
+  // the tape of one node's subtree, bound like prune()'s
+  void        prune (int, std::vector<scene_instr_t>&) const;
+  // the tape for points between two distances from the camera, with the lod nodes that don't
+  // switch in between down to one child. needs bind() with the camera
+  void        prune_lod (float, float, std::vector<scene_instr_t>&) const;
+
+  // the tape as vec4s for the GLSL interpreter, bound to the given sliders
+  void        pack_tape (const vec4&, std::vector<float>&) const;
+};
+
+// runs a tape from compile() or prune()
+float       eval_tape (const std::vector<scene_instr_t>&, vec3);
+vfloat      eval_tape (const std::vector<scene_instr_t>&, const vvec3&);
+// the same with dual numbers, the distance in x and its gradient in yzw
+vec4        eval_tape_dual (const std::vector<scene_instr_t>&, vec3);
+// and with d_bound() over the ball at the point
+vec3        eval_tape_bound (const std::vector<scene_instr_t>&, vec3, float);
+
+// replaces the generated sdf_graph() in fragment.glsl with the tape interpreter,
+// the same for every scene so edits never recompile
+std::string scene_tape_glsl (void);
+// segment tracing looks SCENE_SEGMENT_GROWTH times the distance ahead for its Lipschitz bound,
+// the steps it takes are at most that long
+#define SCENE_SEGMENT_GROWTH 2.0f
+// switches fragment.glsl's marchers to segment tracing on sdf_graph_bound()
+std::string scene_segment_glsl (void);
+
+// the scene fragment.glsl used to hard-code
+constexpr const char* default_scene_src {
+  "(or (plane 0 1 0 20)\n"
+  "    (translate 0 0 20\n"
+  "      (or (rotate $w (torus 7 .7))\n"
+  "          (minus (or-smooth 2\n"
+  "                   (translate 0 1 0 (scale .75 (rotate 1.7 (box .8 .8 .8))))\n"
+  "                   (cylinder $x $y $z  $x $y+5.5 $z  .5))\n"
+  "                 (translate 0 1.5 0 (sphere 1))))))\n"
+};
+
+#endif // _SCENE_H_
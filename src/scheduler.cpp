@@ -0,0 +1,175 @@
+#include "scheduler.hpp"
+
+#include <chrono>
+
+static uint64_t now_ns() {
+  using namespace std::chrono;
+  return static_cast<uint64_t>(duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count());
+}
+
+// fills the deque with tasks [first, last), only called while no worker is running
+void work_deque_t::reset(int first, int last) {
+  const int64_t count { last - first };
+  int64_t capacity { 1 };
+  while (capacity < count) capacity <<= 1;
+
+  if (static_cast<int64_t>(tasks.size()) < capacity) tasks.resize(capacity);
+  mask = capacity - 1;
+
+  for (int64_t i = 0; i < count; ++i)
+    tasks[i] = first + static_cast<int>(i);
+
+  top.store(0, std::memory_order_relaxed);
+  bottom.store(count, std::memory_order_relaxed);
+}
+
+bool work_deque_t::pop(int& task) {
+  const int64_t b { bottom.load(std::memory_order_relaxed) - 1 };
+  bottom.store(b, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  int64_t t { top.load(std::memory_order_relaxed) };
+
+  if (t > b) { // empty
+    bottom.store(b + 1, std::memory_order_relaxed);
+    return false;
+  }
+
+  task = tasks[b & mask];
+  if (t == b) { // last task, race the thieves for it
+    const bool won { top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed) };
+    bottom.store(b + 1, std::memory_order_relaxed);
+    return won;
+  }
+  return true;
+}
+
+bool work_deque_t::steal(int& task) {
+  int64_t t { top.load(std::memory_order_acquire) };
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  const int64_t b { bottom.load(std::memory_order_acquire) };
+
+  if (t >= b) return false;
+
+  task = tasks[t & mask];
+  return top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+}
+
+scheduler_t::scheduler_t(int num_threads) {
+  if (num_threads <= 0)
+    num_threads = glm::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+
+  deques = std::vector<work_deque_t>(num_threads);
+  stats.resize(num_threads);
+  threads.reserve(num_threads);
+  for (int i = 0; i < num_threads; ++i)
+    threads.emplace_back(&scheduler_t::worker, this, i);
+}
+
+scheduler_t::~scheduler_t() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    quit = true;
+  }
+  start_cv.notify_all();
+  for (std::thread& t : threads) t.join();
+}
+
+void scheduler_t::run(int num_tasks, std::function<void(int)> fn) {
+  const uint64_t start { now_ns() };
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    const int n { num_workers() };
+    for (int i = 0; i < n; ++i) {
+      deques[i].reset(static_cast<int>(static_cast<int64_t>(num_tasks) * i / n),
+                      static_cast<int>(static_cast<int64_t>(num_tasks) * (i + 1) / n));
+      stats[i] = worker_stats_t {};
+    }
+    task_fn = std::move(fn);
+    remaining.store(num_tasks);
+    workers_done = 0;
+    ++run_id;
+  }
+  start_cv.notify_all();
+
+  std::unique_lock<std::mutex> lock(mutex);
+  done_cv.wait(lock, [this] { return workers_done == num_workers(); });
+  wall_ns = now_ns() - start;
+}
+
+void scheduler_t::worker(int id) {
+  uint64_t seen_run { 0 };
+  uint32_t rng      { 0x9e3779b9u * static_cast<uint32_t>(id + 1) };
+
+  for (;;) {
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      start_cv.wait(lock, [&] { return quit || run_id != seen_run; });
+      if (quit) return;
+      seen_run = run_id;
+    }
+
+    // counted here and stored once the run is over, the hot loop touches no shared lines
+    worker_stats_t s {};
+    const int      n { num_workers() };
+    uint64_t       t { now_ns() };
+
+    while (remaining.load(std::memory_order_acquire) > 0) {
+      int  task   { 0 };
+      bool stolen { false };
+      bool found  { deques[id].pop(task) };
+
+      // start at a random victim so thieves don't all hammer the same deque
+      if (!found && n > 1) {
+        rng ^= rng << 13; rng ^= rng >> 17; rng ^= rng << 5;
+        const int first { static_cast<int>(rng % static_cast<uint32_t>(n)) };
+        for (int i = 0; i < n && !found; ++i) {
+          const int victim { (first + i) % n };
+          if (victim == id) continue;
+          found = stolen = deques[victim].steal(task);
+          if (!found) ++s.failed_steals;
+        }
+      }
+
+      const uint64_t t_found { now_ns() };
+      s.idle_ns += t_found - t;
+      t = t_found;
+
+      if (!found) {
+        std::this_thread::yield();
+        continue;
+      }
+
+      task_fn(task);
+      remaining.fetch_sub(1, std::memory_order_release);
+
+      t = now_ns();
+      s.busy_ns += t - t_found;
+      s.tasks   += 1;
+      s.steals  += stolen ? 1 : 0;
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      stats[id] = s;
+      ++workers_done;
+    }
+    done_cv.notify_one();
+  }
+}
+
+void scheduler_t::print_stats(FILE* f) const {
+  uint64_t busy { 0 };
+  fprintf(f, "worker    tasks   steals   failed    busy ms    idle ms\n");
+  for (int i = 0; i < num_workers(); ++i) {
+    const worker_stats_t& s { stats[i] };
+    fprintf(f, "%6d %8llu %8llu %8llu %10.3f %10.3f\n", i,
+            static_cast<unsigned long long>(s.tasks),
+            static_cast<unsigned long long>(s.steals),
+            static_cast<unsigned long long>(s.failed_steals),
+            s.busy_ns / 1e6, s.idle_ns / 1e6);
+    busy += s.busy_ns;
+  }
+  // fraction of the wall time the pool spent doing useful work
+  fprintf(f, "efficiency %.1f%% over %.3f ms\n",
+          wall_ns ? 100.0 * busy / (static_cast<double>(wall_ns) * num_workers()) : 0.0, wall_ns / 1e6);
+}
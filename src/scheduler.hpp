@@ -0,0 +1,64 @@
+#ifndef _SCHEDULER_H_
+#define _SCHEDULER_H_
+
+#include "main.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Chase-Lev deque of task indices. The owner pops from the bottom, every
+// other worker steals from the top. Tasks are only added while the pool is
+// parked between runs, so the buffer never grows during a run.
+struct alignas(64) work_deque_t {
+  std::atomic<int64_t> top    { 0 };
+  std::atomic<int64_t> bottom { 0 };
+  std::vector<int>     tasks;
+  int64_t              mask   { 0 };
+
+  void reset (int, int);
+  bool pop   (int&);
+  bool steal (int&);
+};
+
+// per worker counters for the last run, times are in nanoseconds
+struct alignas(64) worker_stats_t {
+  uint64_t tasks          { 0 };
+  uint64_t steals         { 0 }; // tasks taken from another worker
+  uint64_t failed_steals  { 0 }; // victims that turned out to be empty
+  uint64_t busy_ns        { 0 }; // running tasks
+  uint64_t idle_ns        { 0 }; // looking for work
+};
+
+struct scheduler_t {
+  std::vector<std::thread>    threads;
+  std::vector<work_deque_t>   deques;
+  std::vector<worker_stats_t> stats;
+
+  std::mutex                  mutex;
+  std::condition_variable     start_cv;
+  std::condition_variable     done_cv;
+  uint64_t                    run_id       { 0 };
+  int                         workers_done { 0 };
+  bool                        quit         { false };
+
+  std::atomic<int>            remaining    { 0 };
+  uint64_t                    wall_ns      { 0 };
+  std::function<void(int)>    task_fn;
+
+  scheduler_t  (int num_threads = 0); // 0 means one worker per core
+  ~scheduler_t (void);
+
+  // runs fn(0) .. fn(num_tasks-1) across the pool and returns when all are done,
+  // neighbouring indices start out on the same worker
+  void run          (int num_tasks, std::function<void(int)> fn);
+  int  num_workers  (void) const { return static_cast<int>(threads.size()); }
+  void print_stats  (FILE*) const;
+
+  void worker       (int);
+};
+
+#endif // _SCHEDULER_H_
@@ -0,0 +1,219 @@
+#include "sdf.hpp"
+
+float p_mod_1(float& p, float size) {
+  float half_size = size * 0.5f;
+  p = mod(p+half_size, size) - half_size;
+  return floor((p+half_size)/size);
+}
+
+float p_mod_mirror_1(float& p, float size) {
+  float half_size = size * 0.5f;
+  float c = floor((p+half_size)/size);
+  p = (mod(p+half_size, size)-half_size) * (mod(c, 2.0f) * 2.0f-1.0f);
+  return c;
+}
+
+float Sphere(vec3 p, float r) {
+  return length(p) - r;
+}
+
+float Capsule(vec3 p, vec3 a, vec3 b, float r) {
+  vec3 ab = b - a;
+  vec3 ap = p - a;
+  return length(p - (a + clamp(dot(ab, ap) / dot(ab, ab), 0.0f, 1.0f) * ab)) - r;
+}
+
+float Cylinder(vec3 p, vec3 a, vec3 b, float r) {
+  vec3 ab = b - a;
+  vec3 ap = p - a;
+  float t = dot(ab, ap) / dot(ab, ab);
+  float x = length(p - (a + t * ab)) - r;
+  float y = (abs(t - 0.5f) - 0.5f) * length(ab);
+  return length(max(vec2(x, y), 0.0f)) + min(max(x, y), 0.0f);
+}
+
+float Torus(vec3 p, vec2 r) {
+  return length(vec2(length(vec2(p.x, p.z)) - r.x, p.y)) - r.y;
+}
+
+float Box(vec3 p, vec3 s) {
+  return length(max(abs(p)-s, 0.0f));
+}
+
+mat2 Rotate(float a) {
+  float s = sin(a);
+  float c = cos(a);
+  return mat2(c, -s, s, c);
+}
+
+float d_minus(float b, float a) {
+  return max(-a, b);
+}
+
+float d_and(float a, float b) {
+  return max(a, b);
+}
+
+float d_or(float a, float b) {
+  return min(a, b);
+}
+
+float d_or_smooth(float a, float b, float k) {
+  float h = clamp(0.5f + 0.5f * (b - a) / k, 0.0f, 1.0f);
+  return mix(b, a, h) - k * h * (1.0f - h);
+}
+
+float d_lod(float a, float b, float t, float far) {
+  return t < far ? a : b;
+}
+
+vec4 Sphere_dual(vec3 p, float r) {
+  float l = length(p);
+  return vec4(l - r, p / l);
+}
+
+vec4 Capsule_dual(vec3 p, vec3 a, vec3 b, float r) {
+  vec3 ab = b - a;
+  vec3 ap = p - a;
+  vec3 o = p - (a + clamp(dot(ab, ap) / dot(ab, ab), 0.0f, 1.0f) * ab);
+  float l = length(o);
+  return vec4(l - r, o / l);
+}
+
+vec4 Cylinder_dual(vec3 p, vec3 a, vec3 b, float r) {
+  vec3 ab = b - a;
+  vec3 ap = p - a;
+  float t = dot(ab, ap) / dot(ab, ab);
+  vec3 o = p - (a + t * ab);
+  vec4 x = vec4(length(o) - r, normalize(o));
+  vec4 y = vec4((abs(t - 0.5f) - 0.5f) * length(ab), sign(t - 0.5f) * normalize(ab));
+  vec2 m = max(vec2(x.x, y.x), 0.0f);
+  float l = length(m);
+  if (l > 0.0f) return vec4(l, (m.x * vec3(x.y, x.z, x.w) + m.y * vec3(y.y, y.z, y.w)) / l);
+  return x.x > y.x ? x : y;
+}
+
+vec4 Torus_dual(vec3 p, vec2 r) {
+  float l = length(vec2(p.x, p.z));
+  vec2 q = vec2(l - r.x, p.y);
+  float lq = length(q);
+  return vec4(lq - r.y, vec3(p.x * q.x / l, q.y, p.z * q.x / l) / lq);
+}
+
+vec4 Box_dual(vec3 p, vec3 s) {
+  vec3 m = max(abs(p)-s, 0.0f);
+  float l = length(m);
+  return vec4(l, l > 0.0f ? sign(p) * m / l : vec3(0.0f));
+}
+
+vec4 d_minus(vec4 b, vec4 a) {
+  return -a.x > b.x ? -a : b;
+}
+
+vec4 d_and(vec4 a, vec4 b) {
+  return a.x > b.x ? a : b;
+}
+
+vec4 d_or(vec4 a, vec4 b) {
+  return a.x < b.x ? a : b;
+}
+
+vec4 d_or_smooth(vec4 a, vec4 b, float k) {
+  float h = clamp(0.5f + 0.5f * (b.x - a.x) / k, 0.0f, 1.0f);
+  return mix(b, a, h) - vec4(k * h * (1.0f - h), 0.0f, 0.0f, 0.0f);
+}
+
+vec4 d_lod(vec4 a, vec4 b, float t, float far) {
+  return t < far ? a : b;
+}
+
+vec3 d_bound(float d, float r, float lipschitz, float scale) {
+  float e = lipschitz * r + 1e-4f + 1e-5f * abs(d);
+  return vec3(d - e, d + e, lipschitz * scale);
+}
+
+vec3 d_minus(vec3 b, vec3 a) {
+  return vec3(max(-a.y, b.x), max(-a.x, b.y), -a.x < b.x ? b.z : max(a.z, b.z));
+}
+
+vec3 d_and(vec3 a, vec3 b) {
+  return vec3(max(a.x, b.x), max(a.y, b.y), a.y < b.x ? b.z : b.y < a.x ? a.z : max(a.z, b.z));
+}
+
+vec3 d_or(vec3 a, vec3 b) {
+  return vec3(min(a.x, b.x), min(a.y, b.y), a.x > b.y ? b.z : b.x > a.y ? a.z : max(a.z, b.z));
+}
+
+vec3 d_or_smooth(vec3 a, vec3 b, float k) {
+  float l = a.x - b.y >= k ? b.z : b.x - a.y >= k ? a.z : max(a.z, b.z);
+  return vec3(min(a.x, b.x) - 0.25f * abs(k), min(a.y, b.y), l);
+}
+
+vec3 d_lod(vec3 a, vec3 b, float t, float r, float far) {
+  if (t + r < far) return a;
+  if (t - r >= far) return b;
+  return vec3(min(a.x, b.x), max(a.y, b.y), max(a.z, b.z));
+}
+
+vfloat Sphere(const vvec3& p, float r) {
+  return vlength(p) - r;
+}
+
+vfloat Capsule(const vvec3& p, vec3 a, vec3 b, float r) {
+  const vec3  ab { b - a };
+  const vvec3 ap { p - a };
+  const vfloat t { vclamp(vdot(ab, ap) / dot(ab, ab), 0.0f, 1.0f) };
+  return vlength(p - (vvec3(a) + vvec3(ab) * t)) - r;
+}
+
+vfloat Cylinder(const vvec3& p, vec3 a, vec3 b, float r) {
+  const vec3  ab { b - a };
+  const vvec3 ap { p - a };
+  vfloat t = vdot(ab, ap) / dot(ab, ab);
+  vfloat x = vlength(p - (vvec3(a) + vvec3(ab) * t)) - r;
+  vfloat y = (vabs(t - 0.5f) - 0.5f) * length(ab);
+  vfloat mx = vmax(x, 0.0f);
+  vfloat my = vmax(y, 0.0f);
+  return vsqrt(mx*mx + my*my) + vmin(vmax(x, y), 0.0f);
+}
+
+vfloat Torus(const vvec3& p, vec2 r) {
+  vfloat q = vsqrt(p.x*p.x + p.z*p.z) - r.x;
+  return vsqrt(q*q + p.y*p.y) - r.y;
+}
+
+vfloat Box(const vvec3& p, vec3 s) {
+  return vlength(vvec3(vmax(vabs(p.x) - s.x, 0.0f),
+                       vmax(vabs(p.y) - s.y, 0.0f),
+                       vmax(vabs(p.z) - s.z, 0.0f)));
+}
+
+// p.xy *= Rotate(a), the angle is the same for every lane
+void rotate_xy(vvec3& p, float a) {
+  const float s = sin(a);
+  const float c = cos(a);
+  const vfloat x = p.x*c - p.y*s;
+  p.y = p.x*s + p.y*c;
+  p.x = x;
+}
+
+vfloat d_minus(vfloat b, vfloat a) {
+  return vmax(-a, b);
+}
+
+vfloat d_and(vfloat a, vfloat b) {
+  return vmax(a, b);
+}
+
+vfloat d_or(vfloat a, vfloat b) {
+  return vmin(a, b);
+}
+
+vfloat d_or_smooth(vfloat a, vfloat b, float k) {
+  vfloat h = vclamp(0.5f + 0.5f * (b - a) / k, 0.0f, 1.0f);
+  return vmix(b, a, h) - k * h * (1.0f - h);
+}
+
+vfloat d_lod(vfloat a, vfloat b, vfloat t, float far) {
+  return select(t < vfloat(far), a, b);
+}
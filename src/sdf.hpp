@@ -0,0 +1,62 @@
+#ifndef _SDF_H_
+#define _SDF_H_
+
+#include "main.hpp"
+#include "simd.hpp"
+
+// C++ mirror of the distance functions in fragment.glsl, keep the two in sync.
+// the scene itself is a scene_t, see scene.hpp
+
+float p_mod_1        (float&, float);
+float p_mod_mirror_1 (float&, float);
+
+float Sphere   (vec3, float);
+float Capsule  (vec3, vec3, vec3, float);
+float Cylinder (vec3, vec3, vec3, float);
+float Torus    (vec3, vec2);
+float Box      (vec3, vec3);
+mat2  Rotate   (float);
+
+float d_minus     (float, float);
+float d_and       (float, float);
+float d_or        (float, float);
+float d_or_smooth (float, float, float);
+// a when t, the point's distance from the camera, is below far, b from there on
+float d_lod       (float, float, float, float);
+
+// dual numbers like fragment.glsl's: x is the distance and yzw its gradient in p
+vec4  Sphere_dual   (vec3, float);
+vec4  Capsule_dual  (vec3, vec3, vec3, float);
+vec4  Cylinder_dual (vec3, vec3, vec3, float);
+vec4  Torus_dual    (vec3, vec2);
+vec4  Box_dual      (vec3, vec3);
+
+vec4  d_minus     (vec4, vec4);
+vec4  d_and       (vec4, vec4);
+vec4  d_or        (vec4, vec4);
+vec4  d_or_smooth (vec4, vec4, float);
+vec4  d_lod       (vec4, vec4, float, float);
+
+// bounds of a distance over a ball, and in z the Lipschitz bound of what decides it there
+vec3  d_bound     (float, float, float, float);
+vec3  d_minus     (vec3, vec3);
+vec3  d_and       (vec3, vec3);
+vec3  d_or        (vec3, vec3);
+vec3  d_or_smooth (vec3, vec3, float);
+vec3  d_lod       (vec3, vec3, float, float, float); // over a ball of the given radius at t
+
+// packet versions, one point per lane
+vfloat Sphere   (const vvec3&, float);
+vfloat Capsule  (const vvec3&, vec3, vec3, float);
+vfloat Cylinder (const vvec3&, vec3, vec3, float);
+vfloat Torus    (const vvec3&, vec2);
+vfloat Box      (const vvec3&, vec3);
+void   rotate_xy(vvec3&, float);
+
+vfloat d_minus     (vfloat, vfloat);
+vfloat d_and       (vfloat, vfloat);
+vfloat d_or        (vfloat, vfloat);
+vfloat d_or_smooth (vfloat, vfloat, float);
+vfloat d_lod       (vfloat, vfloat, vfloat, float);
+
+#endif // _SDF_H_
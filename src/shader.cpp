@@ -1,81 +1,141 @@
 #include "shader.hpp"
 
-shader_t::shader_t() {
-  program = glCreateProgram();
-    
+static void log_shader_error(GLuint shader) {
+  int log_len { 0 };
+  int max_len { 0 };
+
+  glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &max_len);
+
+  GLchar info_log[1024];
+
+  glGetShaderInfoLog(shader, sizeof(info_log), &log_len, info_log);
+  SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "%s", info_log);
+}
+
+// starts building the program for the current fragment.glsl, finish_program says when it's done.
+// without a worker thread this runs on the drawing thread: with KHR_parallel_shader_compile
+// the link completes on the driver's threads, but some drivers still parse in glCompileShader
+void shader_t::begin_program() {
+  size_t size {0};
+  char* fragment_src { slurp_file(fragment_path, &size) };
+  std::string source { preprocess_source(fragment_src, size) };
+  free(static_cast<void*>(fragment_src));
+
   {
+    std::lock_guard<std::mutex> lock { worker_mutex };
+    const size_t marker { source.find(SCENE_MARKER) };
+    if (marker != std::string::npos) source.replace(marker, strlen(SCENE_MARKER), scene_src);
+  }
+
+  pending_start = std::chrono::steady_clock::now();
+  pending_key   = cache.key(vertex_src, source);
+  pending       = glCreateProgram();
+  pending_frag  = 0;
+  if ((pending_cached = cache.load(pending, pending_key))) return;
+
+  // the vertex shader never changes, it's only compiled the first time the cache misses
+  if (!vert_shader) {
     vert_shader = glCreateShader(GL_VERTEX_SHADER);
-    GLuint shader = vert_shader;
-    
-    glShaderSource(shader, 1, &vertex_src, NULL);
-    glCompileShader(shader);
+    glShaderSource(vert_shader, 1, &vertex_src, NULL);
+    glCompileShader(vert_shader);
 
     GLint shader_compiled { GL_FALSE };
-    glGetShaderiv(shader, GL_COMPILE_STATUS, &shader_compiled);
-
+    glGetShaderiv(vert_shader, GL_COMPILE_STATUS, &shader_compiled);
     if (shader_compiled != GL_TRUE) {
-      int log_len { 0 };
-      int max_len { 0 };
+      log_shader_error(vert_shader);
+      exit(1);
+    }
+  }
 
-      glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &max_len);
+  pending_frag = glCreateShader(GL_FRAGMENT_SHADER);
+  const char* src    { source.c_str() };
+  const GLint length { static_cast<GLint>(source.size()) };
+  glShaderSource(pending_frag, 1, &src, &length);
+  glCompileShader(pending_frag);
 
-      GLchar info_log[1024];
+  // linking straight away is fine, a fragment shader that didn't compile makes the link fail
+  if (cache.enabled) glProgramParameteri(pending, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+  glAttachShader(pending, vert_shader);
+  glAttachShader(pending, pending_frag);
+  glLinkProgram(pending);
+  glDetachShader(pending, vert_shader);
+  glDetachShader(pending, pending_frag);
+}
 
-      glGetShaderInfoLog(shader, max_len, &log_len, info_log);
-      SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "%s", info_log);
-      exit(1);
-    }
+// 1 when the pending program linked, 0 while it's still compiling, -1 when it failed and was dropped
+int shader_t::finish_program(bool wait) {
+  if (!pending) return -1;
+
+  if (!wait && parallel) {
+    GLint done { GL_FALSE };
+    glGetProgramiv(pending, GL_COMPLETION_STATUS_KHR, &done);
+    if (!done) return 0;
   }
-  
-  {
-    size_t size {0};
-    char* fragment_src { slurp_file(fragment_path, &size) };
-    frag_shader = glCreateShader(GL_FRAGMENT_SHADER);
-    GLuint shader = frag_shader;
-    
-    glShaderSource(shader, 1, &fragment_src, &static_cast<int>(size));
-    glCompileShader(shader);
-
-    free(static_cast<void*>(fragment_src));
-    
+
+  bool ok { true };
+  if (pending_frag) {
     GLint shader_compiled { GL_FALSE };
-    glGetShaderiv(shader, GL_COMPILE_STATUS, &shader_compiled);
+    glGetShaderiv(pending_frag, GL_COMPILE_STATUS, &shader_compiled);
     if (shader_compiled != GL_TRUE) {
-      int log_len { 0 };
-      int max_len { 0 };
-      
-      glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &max_len);
-      
-      GLchar info_log[1024];
-      
-      glGetShaderInfoLog(shader, max_len, &log_len, info_log);
-      SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "%s", info_log);
-      exit(1);
+      log_shader_error(pending_frag);
+      ok = false;
     }
+    glDeleteShader(pending_frag);
+    pending_frag = 0;
   }
 
-  glAttachShader(program, vert_shader);
-  glAttachShader(program, frag_shader);
-  glLinkProgram(program);
-  glDetachShader(program, vert_shader);
-  glDetachShader(program, frag_shader);
-
-  GLint linked;
-  glGetProgramiv(program, GL_LINK_STATUS, &linked);
-  if (linked != GL_TRUE) {
+  GLint linked { GL_FALSE };
+  glGetProgramiv(pending, GL_LINK_STATUS, &linked);
+  if (ok && linked != GL_TRUE) {
     //GLsizei log_length = 0;
     GLchar message[1024];
-    glGetProgramInfoLog(program, 1024, NULL, message);
-    SDL_Log("%s", message);
-    exit(1);
+    glGetProgramInfoLog(pending, 1024, NULL, message);
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "%s", message);
+    ok = false;
   }
-  
+  if (!ok) {
+    glDeleteProgram(pending);
+    pending = 0;
+    return -1;
+  }
+
+  // a binary straight from the cache has nothing to store
+  const bool compiled { !pending_cached };
+  if (compiled) cache.store(pending, pending_key);
+  const auto end { std::chrono::steady_clock::now() };
+  SDL_Log("program %016llx %s in %.2f ms", static_cast<unsigned long long>(pending_key),
+          compiled ? "compiled" : "loaded from the cache",
+          std::chrono::duration<double, std::milli>(end - pending_start).count());
+  return 1;
+}
+
+// makes the pending program current, only ever between frames so a draw never sees half of it
+void shader_t::adopt_program() {
+  if (program) glDeleteProgram(program);
+  program = pending;
+  pending = 0;
+
   vert_attrib = glGetAttribLocation(program, "pos");
 
   // get uniform locations
   for (int i = 0; i < NUM_UNIFORMS; ++i)
     uniform_locs[i] = glGetUniformLocation(program, uniform_names[i]);
 
+  // #version 330 has no binding qualifier, and a binary from the cache needs it set again anyway
+  tape_block = glGetUniformBlockIndex(program, "tape_block");
+  if (tape_block != GL_INVALID_INDEX) glUniformBlockBinding(program, tape_block, TAPE_BINDING);
+}
+
+shader_t::shader_t(const std::string& scene_glsl) : scene_src(scene_glsl) {
+  parallel = GLEW_KHR_parallel_shader_compile || GLEW_ARB_parallel_shader_compile;
+  if (GLEW_KHR_parallel_shader_compile)      glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+  else if (GLEW_ARB_parallel_shader_compile) glMaxShaderCompilerThreadsARB(0xFFFFFFFF);
+
+  // nothing to draw with yet, the first program is waited for
+  begin_program();
+  if (finish_program(true) != 1) exit(1);
+  adopt_program();
+
   //VBO data
   constexpr const GLfloat vertexData[] = {
     -1.f, -1.f,
@@ -87,6 +147,9 @@ shader_t::shader_t() {
   //IBO data
   constexpr const GLuint indexData[] { 0, 1, 2, 3 };
   
+  glGenVertexArrays(1, &vao);
+  glBindVertexArray(vao);
+
   //Create VBO
   glGenBuffers( 1, &vbo);
   glBindBuffer( GL_ARRAY_BUFFER, vbo);
@@ -96,77 +159,324 @@ shader_t::shader_t() {
   glGenBuffers( 1, &ibo);
   glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, ibo);
   glBufferData( GL_ELEMENT_ARRAY_BUFFER, 4 * sizeof(GLuint), indexData, GL_STATIC_DRAW );
+
+  glBindVertexArray(0);
 }
 
-void shader_t::recompile() {
-  glDeleteProgram(program);
-  program = glCreateProgram();
-  
+shader_t::~shader_t() {
+  if (tape_buffer) glDeleteBuffers(1, &tape_buffer);
+  if (tile_texture) {
+    glDeleteTextures(1, &tile_texture);
+    glDeleteBuffers(1, &tile_buffer);
+  }
+  if (bvh_texture) {
+    glDeleteTextures(1, &bvh_texture);
+    glDeleteBuffers(1, &bvh_buffer);
+  }
+  if (mesh_texture) glDeleteTextures(1, &mesh_texture);
+  if (brick_textures[0]) glDeleteTextures(3, brick_textures);
+  if (prepass_fbos[0]) {
+    glDeleteFramebuffers(2, prepass_fbos);
+    glDeleteTextures(2, prepass_textures);
+  }
+  if (!worker.joinable()) return;
   {
-    size_t size {0};
-    char* fragment_src { slurp_file(fragment_path, &size) };
-    GLuint new_shader { glCreateShader(GL_FRAGMENT_SHADER) };
-    
-    glShaderSource(new_shader, 1, &fragment_src, &static_cast<int>(size));
-    glCompileShader(new_shader);
-
-    free(static_cast<void*>(fragment_src));
-    
-    GLint shader_compiled { GL_FALSE };
-    glGetShaderiv(new_shader, GL_COMPILE_STATUS, &shader_compiled);
-    if (shader_compiled != GL_TRUE) {
-      int log_len { 0 };
-      int max_len { 0 };
-      
-      glGetShaderiv(new_shader, GL_INFO_LOG_LENGTH, &max_len);
-      
-      GLchar info_log[1024];
-      
-      glGetShaderInfoLog(new_shader, max_len, &log_len, info_log);
-      SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "%s",info_log);
-
-      glDeleteShader(new_shader);
-    } else {
-      glDeleteShader(frag_shader);
-      frag_shader = new_shader;
+    std::lock_guard<std::mutex> lock { worker_mutex };
+    worker_quit = true;
+  }
+  worker_cv.notify_one();
+  worker.join();
+}
+
+// builds run on their own thread from here on, make_current(true) binds a context that shares
+// objects with the drawing one on the calling thread and make_current(false) releases it
+void shader_t::start_worker(std::function<bool(bool)> make_current) {
+  worker = std::thread([this, make_current] () {
+    if (!make_current(true)) {
+      SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Could not bind the shader compile context");
+      return;
+    }
+
+    std::unique_lock<std::mutex> lock { worker_mutex };
+    for (;;) {
+      // the last result has to be picked up by poll before the next build overwrites pending
+      worker_cv.wait(lock, [this] { return worker_quit || (worker_request && worker_status == 0); });
+      if (worker_quit) break;
+      worker_request = false;
+      lock.unlock();
+
+      begin_program();
+      int status { finish_program(true) };
+      glFinish(); // the drawing context only sees a finished program
+
+      lock.lock();
+      if (worker_request && status > 0) { // edited again while building, that one wins
+        glDeleteProgram(pending);
+        pending = 0;
+        continue;
+      }
+      worker_status = status;
     }
+    lock.unlock();
+    make_current(false);
+  });
+  has_worker = true;
+}
+
+void shader_t::set_scene(const std::string& scene_glsl) {
+  {
+    std::lock_guard<std::mutex> lock { worker_mutex };
+    if (scene_glsl == scene_src) return;
+    scene_src = scene_glsl;
   }
+  recompile();
+}
 
-  glAttachShader(program, vert_shader);
-  glAttachShader(program, frag_shader);
-  glLinkProgram(program);
-  glDetachShader(program, vert_shader);
-  glDetachShader(program, frag_shader);
+// scene edits only change the tape, which costs an upload instead of a rebuild
+bool shader_t::set_tape(const std::vector<float>& texels) {
+  if (tape_buffer && texels == tape_data) return false;
+  tape_data = texels;
 
-  GLint linked;
-  glGetProgramiv(program, GL_LINK_STATUS, &linked);
-  if (linked != GL_TRUE) {
-    //GLsizei log_length = 0;
-    GLchar message[1024];
-    glGetProgramInfoLog(program, 1024, NULL, message);
-    SDL_Log("%s", message);
-    exit(1);
+  const int length { static_cast<int>(texels.size() / (SCENE_TAPE_STRIDE * 4)) };
+  if (length > SCENE_MAX_TAPE) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Scene tape has %d instructions, the interpreter holds %d",
+                 length, SCENE_MAX_TAPE);
+    tape_length = 0;
+    return false;
   }
-  
-  vert_attrib = glGetAttribLocation(program, "pos");
 
-  for (int i = 0; i < NUM_UNIFORMS; ++i)
-    uniform_locs[i] = glGetUniformLocation(program, uniform_names[i]);
+  const auto start { std::chrono::steady_clock::now() };
+  // the whole block is allocated once, std140 needs it as big as the shader declares it
+  constexpr GLsizeiptr block_size { SCENE_MAX_TAPE * SCENE_TAPE_STRIDE * 4 * sizeof(float) };
+  if (!tape_buffer) {
+    glGenBuffers(1, &tape_buffer);
+    glBindBuffer(GL_UNIFORM_BUFFER, tape_buffer);
+    glBufferData(GL_UNIFORM_BUFFER, block_size, NULL, GL_DYNAMIC_DRAW);
+  }
+  glBindBuffer(GL_UNIFORM_BUFFER, tape_buffer);
+  if (!texels.empty()) glBufferSubData(GL_UNIFORM_BUFFER, 0, texels.size() * sizeof(float), texels.data());
+  glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+  tape_length    = length;
+  tape_upload_us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+  return true;
+}
+
+// every frame the camera moves, orphaning the old storage so the upload doesn't wait on the draw using it
+static void upload_texture_buffer(GLuint& buffer, GLuint& texture, GLenum format, const void* data, size_t size) {
+  if (!texture) {
+    glGenBuffers(1, &buffer);
+    glGenTextures(1, &texture);
+  }
+  glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+  glBufferData(GL_TEXTURE_BUFFER, size, data, GL_STREAM_DRAW);
+  glBindTexture(GL_TEXTURE_BUFFER, texture);
+  glTexBuffer(GL_TEXTURE_BUFFER, format, buffer);
+  glBindTexture(GL_TEXTURE_BUFFER, 0);
+  glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+void shader_t::set_tile_lists(const std::vector<uint32_t>& lists, int num_tiles_x) {
+  upload_texture_buffer(tile_buffer, tile_texture, GL_R32UI, lists.data(), lists.size() * sizeof(uint32_t));
+  tiles_x = num_tiles_x;
+}
+
+void shader_t::set_bvh(const std::vector<float>& texels) {
+  upload_texture_buffer(bvh_buffer, bvh_texture, GL_RGBA32F, texels.data(), texels.size() * sizeof(float));
+}
+
+// single channel 3D texture, clamped so filtering at the edges of the grid stays inside it
+static void upload_texture_3d(GLuint texture, GLenum format, GLenum type, GLint filter, ivec3 size, const void* data) {
+  glBindTexture(GL_TEXTURE_3D, texture);
+  glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, filter);
+  glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, filter);
+  glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+  glTexImage3D(GL_TEXTURE_3D, 0, format, size.x, size.y, size.z, 0,
+               format == GL_R32I ? GL_RED_INTEGER : GL_RED, type, data);
+  glBindTexture(GL_TEXTURE_3D, 0);
+}
+
+void shader_t::set_bricks(const brick_map_t& map) {
+  brick_cell = map.empty() ? 0.0f : map.cell;
+  if (map.empty()) return;
+  if (!brick_textures[0]) glGenTextures(3, brick_textures);
+  brick_lo = map.lo;
+  upload_texture_3d(brick_textures[0], GL_R32F, GL_FLOAT, GL_LINEAR, map.cells + 1, map.coarse.data());
+  upload_texture_3d(brick_textures[1], GL_R32I, GL_INT, GL_NEAREST, map.cells, map.index.data());
+  upload_texture_3d(brick_textures[2], GL_R32F, GL_FLOAT, GL_LINEAR, map.slots * (BRICK_SIZE + 1), map.atlas.data());
+}
+
+void shader_t::set_meshes(const scene_t& scene) {
+  if (scene.meshes.empty()) return;
+  if (!mesh_texture) glGenTextures(1, &mesh_texture);
+  ivec3              size;
+  std::vector<float> texels;
+  scene.mesh_atlas(size, texels);
+  upload_texture_3d(mesh_texture, GL_R32F, GL_FLOAT, GL_LINEAR, size, texels.data());
+}
+
+void shader_t::recompile() {
+  if (has_worker) {
+    {
+      std::lock_guard<std::mutex> lock { worker_mutex };
+      worker_request = true;
+    }
+    worker_cv.notify_one();
+    return;
+  }
+
+  // a newer edit replaces a compile that's still running
+  if (pending) {
+    if (pending_frag) glDeleteShader(pending_frag);
+    glDeleteProgram(pending);
+  }
+  begin_program();
+}
+
+bool shader_t::poll() {
+  int status { 0 };
+  if (has_worker) {
+    status = worker_status.load();
+    if (status == 0) return false;
+  } else {
+    if (!pending) return false;
+    status = finish_program(false);
+  }
+
+  if (status < 0) SDL_Log("%s didn't build, keeping the current program", fragment_path);
+  if (status > 0) adopt_program();
+
+  if (has_worker) {
+    {
+      std::lock_guard<std::mutex> lock { worker_mutex };
+      worker_status = 0;
+    }
+    worker_cv.notify_one();
+  }
+  return status > 0;
 }
 
 void shader_t::run(int window_size[2], ray_march_params_t rmp, float slider_values[4], const camera_t& camera) {
   glUseProgram(program);
-#if NUM_UNIFORMS != 7
+#if NUM_UNIFORMS != 27
 #error "exhaustive handling of uniforms"
 #endif
   glUniform2f(uniform_locs[U_RESOLUTION], static_cast<float>(window_size[0]), static_cast<float>(window_size[1]));
   glUniform1i(uniform_locs[U_MAX_STEPS], rmp.max_steps);
   glUniform1f(uniform_locs[U_MAX_DIST], rmp.max_dist);
   glUniform1f(uniform_locs[U_SURF_DIST], rmp.surf_dist);
+  glUniform1f(uniform_locs[U_RELAXATION], rmp.relaxation);
+  glUniform1i(uniform_locs[U_SHADOW_STEPS], rmp.shadow_steps);
+  glUniform1f(uniform_locs[U_PENUMBRA], rmp.penumbra);
+  glUniform1f(uniform_locs[U_FOOTPRINT], rmp.footprint);
   glUniform4f(uniform_locs[U_SLIDER], slider_values[0], slider_values[1], slider_values[2], slider_values[3]);
   glUniform3f(uniform_locs[U_CAMERA_POS], camera.position.x, camera.position.y, camera.position.z);
   glUniform2f(uniform_locs[U_MOUSE], camera.yaw, camera.pitch);
+  glUniform1i(uniform_locs[U_HEATMAP], rmp.heatmap);
+  glUniform1f(uniform_locs[U_HEATMAP_MAX], rmp.heatmap_max);
+  if (tape_block != GL_INVALID_INDEX) {
+    glBindBufferBase(GL_UNIFORM_BUFFER, TAPE_BINDING, tape_buffer);
+    glUniform1i(uniform_locs[U_TAPE_LENGTH], tape_length);
+  }
+  if (uniform_locs[U_TILE_LISTS] >= 0 && tile_texture) {
+    glActiveTexture(GL_TEXTURE0 + TILE_UNIT);
+    glBindTexture(GL_TEXTURE_BUFFER, tile_texture);
+    glActiveTexture(GL_TEXTURE0);
+    glUniform1i(uniform_locs[U_TILE_LISTS], TILE_UNIT);
+    glUniform1i(uniform_locs[U_TILES_X], tiles_x);
+  }
+  if (uniform_locs[U_BVH] >= 0 && bvh_texture) {
+    glActiveTexture(GL_TEXTURE0 + BVH_UNIT);
+    glBindTexture(GL_TEXTURE_BUFFER, bvh_texture);
+    glActiveTexture(GL_TEXTURE0);
+    glUniform1i(uniform_locs[U_BVH], BVH_UNIT);
+  }
+  if (uniform_locs[U_BRICK_CELL] >= 0) {
+    // the samplers are set either way, an empty map never reads them
+    if (brick_textures[0]) {
+      for (int i = 0; i < 3; ++i) {
+        glActiveTexture(GL_TEXTURE0 + BRICK_COARSE_UNIT + i);
+        glBindTexture(GL_TEXTURE_3D, brick_textures[i]);
+      }
+      glActiveTexture(GL_TEXTURE0);
+    }
+    glUniform1i(uniform_locs[U_BRICK_COARSE], BRICK_COARSE_UNIT);
+    glUniform1i(uniform_locs[U_BRICK_INDEX], BRICK_INDEX_UNIT);
+    glUniform1i(uniform_locs[U_BRICK_ATLAS], BRICK_ATLAS_UNIT);
+    glUniform3f(uniform_locs[U_BRICK_LO], brick_lo.x, brick_lo.y, brick_lo.z);
+    glUniform1f(uniform_locs[U_BRICK_CELL], brick_cell);
+  }
+  if (uniform_locs[U_MESHES] >= 0 && mesh_texture) {
+    glActiveTexture(GL_TEXTURE0 + MESH_UNIT);
+    glBindTexture(GL_TEXTURE_3D, mesh_texture);
+    glActiveTexture(GL_TEXTURE0);
+    glUniform1i(uniform_locs[U_MESHES], MESH_UNIT);
+  }
+  if (uniform_locs[U_ROTATE] >= 0 && !rotations.empty())
+    glUniform2fv(uniform_locs[U_ROTATE], static_cast<GLsizei>(rotations.size() / 2), rotations.data());
+  glUniform1i(uniform_locs[U_START], PREPASS_UNIT);
+  glUniform1i(uniform_locs[U_START_SCALE], 0);
+  if (rmp.prepass) prepass(window_size);
+  glUniform1i(uniform_locs[U_PREPASS], 0);
   
+  draw_quad();
+  glUseProgram(0);
+}
+
+// the same program draws each pass into its own R32F target, the bound framebuffer and the
+// viewport are put back for the full resolution one
+void shader_t::prepass(int window_size[2]) {
+  const int scales[2] { PREPASS_COARSE, PREPASS_FINE };
+  GLint framebuffer { 0 };
+  GLint viewport[4];
+  glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &framebuffer);
+  glGetIntegerv(GL_VIEWPORT, viewport);
+
+  if (!prepass_fbos[0]) {
+    glGenFramebuffers(2, prepass_fbos);
+    glGenTextures(2, prepass_textures);
+  }
+  if (prepass_size[0] != window_size[0] || prepass_size[1] != window_size[1]) {
+    for (int i = 0; i < 2; ++i) {
+      glBindTexture(GL_TEXTURE_2D, prepass_textures[i]);
+      glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, (window_size[0] + scales[i] - 1) / scales[i],
+                   (window_size[1] + scales[i] - 1) / scales[i], 0, GL_RED, GL_FLOAT, NULL);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+      glBindFramebuffer(GL_FRAMEBUFFER, prepass_fbos[i]);
+      glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, prepass_textures[i], 0);
+      const GLenum status { glCheckFramebufferStatus(GL_FRAMEBUFFER) };
+      if (status != GL_FRAMEBUFFER_COMPLETE) {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Prepass framebuffer 1/%d incomplete: 0x%x", scales[i], status);
+        exit(1);
+      }
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+    prepass_size[0] = window_size[0];
+    prepass_size[1] = window_size[1];
+  }
+
+  glActiveTexture(GL_TEXTURE0 + PREPASS_UNIT);
+  for (int i = 0; i < 2; ++i) {
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, prepass_fbos[i]);
+    glViewport(0, 0, (window_size[0] + scales[i] - 1) / scales[i], (window_size[1] + scales[i] - 1) / scales[i]);
+    glUniform1i(uniform_locs[U_PREPASS], scales[i]);
+    draw_quad();
+    // each pass starts the next one
+    glBindTexture(GL_TEXTURE_2D, prepass_textures[i]);
+    glUniform1i(uniform_locs[U_START_SCALE], scales[i]);
+  }
+  glActiveTexture(GL_TEXTURE0);
+
+  glBindFramebuffer(GL_DRAW_FRAMEBUFFER, static_cast<GLuint>(framebuffer));
+  glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+}
+
+void shader_t::draw_quad() {
+  glBindVertexArray(vao);
   glEnableVertexAttribArray(vert_attrib);
   
   glBindBuffer(GL_ARRAY_BUFFER, vbo);
@@ -176,6 +486,5 @@ void shader_t::run(int window_size[2], ray_march_params_t rmp, float slider_valu
   glDrawElements(GL_TRIANGLE_FAN, 4, GL_UNSIGNED_INT, NULL);
   
   glDisableVertexAttribArray(vert_attrib);
-  
-  glUseProgram(0);
+  glBindVertexArray(0);
 }
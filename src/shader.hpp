@@ -1,24 +1,109 @@
 #ifndef _SHADER_H
 #define _SHADER_H
 #include "main.hpp"
+#include "program_cache.hpp"
+#include "scene.hpp"
+#include "brick_map.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
 
 struct shader_t {
-  GLuint program;
+  GLuint program { 0 };
+  
+  GLuint vert_shader { 0 }; // this is cached because it doesn't change
   
-  GLuint vert_shader; // this is cached because it doesn't change
-  GLuint frag_shader; // in case the new shader can't compile
+  program_cache_t cache;
+  std::string     scene_src; // generated sdf_graph, guarded by worker_mutex
+
+  // hot reload in flight, run keeps drawing with program until poll swaps this in.
+  // owned by the worker while it builds, by the drawing thread once worker_status is set
+  GLuint   pending        { 0     };
+  GLuint   pending_frag   { 0     };
+  bool     pending_cached { false };
+  uint64_t pending_key    { 0     };
+  bool     parallel       { false }; // KHR_parallel_shader_compile, completion can be polled
+  std::chrono::steady_clock::time_point pending_start;
+
+  bool                    has_worker     { false };
+  std::thread             worker;
+  std::mutex              worker_mutex;
+  std::condition_variable worker_cv;
+  bool                    worker_request { false }; // guarded by worker_mutex
+  bool                    worker_quit    { false };
+  std::atomic<int>        worker_status  { 0 }; // result of finish_program, 0 until there is one
   
+  GLuint vao; // core profile contexts (mesa) refuse to draw without one
   GLuint vbo;
   GLuint ibo;
   
   GLint  vert_attrib;
+
+  // scene tape for the interpreter in fragment.glsl, a uniform buffer on TAPE_BINDING
+  GLuint             tape_buffer    { 0 };
+  GLuint             tape_block     { GL_INVALID_INDEX }; // of the current program, invalid unless it interprets
+  int                tape_length    { 0 };   // instructions
+  std::vector<float> tape_data;              // last upload, unchanged tapes aren't sent again
+  double             tape_upload_us { 0.0 };
+
+  // tile_cull_t lists for the primary rays, a R32UI texture buffer on TILE_UNIT
+  GLuint             tile_buffer  { 0 };
+  GLuint             tile_texture { 0 };
+  int                tiles_x      { 0 };
+  // scene_bvh_t texels for every sdf_scene call, a RGBA32F texture buffer on BVH_UNIT
+  GLuint             bvh_buffer   { 0 };
+  GLuint             bvh_texture  { 0 };
+  // brick_map_t coarse samples, index and atlas as 3D textures on BRICK_COARSE_UNIT onwards
+  GLuint             brick_textures[3] { 0, 0, 0 };
+  vec3               brick_lo     { 0.0f };
+  float              brick_cell   { 0.0f }; // 0 while there's no map, the marchers evaluate the scene
+  // scene_t::mesh_atlas as a 3D texture on MESH_UNIT
+  GLuint             mesh_texture { 0 };
+  // scene_t::bind_rotations for the generated scene's u_rotate
+  std::vector<float> rotations;
+  // start distances of the PREPASS_COARSE and PREPASS_FINE passes, R32F, on PREPASS_UNIT
+  GLuint             prepass_fbos[2]     { 0, 0 };
+  GLuint             prepass_textures[2] { 0, 0 };
+  int                prepass_size[2]     { 0, 0 }; // of the full resolution frame they were made for
   
-  shader_t (void);
+  shader_t  (const std::string&); // the scene's glsl
+  ~shader_t (void);
   void run (int [2], ray_march_params_t, float [4], const camera_t&);
-  void recompile (void);
+  void prepass (int [2]); // from run, draws into the prepass targets and leaves the fine one bound
+  void draw_quad (void);
+  void recompile (void); // starts building fragment.glsl again and returns straight away
+  void set_scene (const std::string&); // rebuilds when the generated glsl changed
+  bool poll      (void); // call once a frame, true when the new program was swapped in
+  void start_worker (std::function<bool(bool)>);
+  bool set_tape     (const std::vector<float>&); // scene_t::pack_tape output, true when it was uploaded
+  void set_tile_lists (const std::vector<uint32_t>&, int); // tile_cull_t lists and tiles_x
+  void set_bvh        (const std::vector<float>&); // scene_bvh_t texels
+  void set_bricks     (const brick_map_t&); // after every bake
+  void set_meshes     (const scene_t&); // after every load
+  void set_rotations  (const std::vector<float>& values) { rotations = values; } // when the sliders move
+
+  void begin_program  (void);
+  int  finish_program (bool);
+  void adopt_program  (void);
 };
 
-constexpr const char* fragment_path { ".\\src\\fragment.glsl" };
+constexpr const char* fragment_path { "./src/fragment.glsl" };
+// line in fragment.glsl that the scene's glsl replaces
+#define SCENE_MARKER "#pragma sdf_scene"
+// uniform buffer binding of tape_block
+#define TAPE_BINDING 0
+#define TILE_UNIT    1
+#define BVH_UNIT     2
+#define BRICK_COARSE_UNIT 3
+#define BRICK_INDEX_UNIT  4
+#define BRICK_ATLAS_UNIT  5
+#define MESH_UNIT         6
+#define PREPASS_UNIT      7
 
 constexpr const char* vertex_src {
   "#version 330 core\n"
@@ -28,19 +113,39 @@ constexpr const char* vertex_src {
   "}"
 };
 
-#define NUM_UNIFORMS 7
+#define NUM_UNIFORMS 27
 static GLint uniform_locs[NUM_UNIFORMS] {0};
 constexpr const char* uniform_names[NUM_UNIFORMS] = {
   "u_resolution",
   "u_max_steps",
   "u_max_dist",
   "u_surf_dist",
+  "u_relaxation",
+  "u_shadow_steps",
+  "u_penumbra",
+  "u_footprint",
   "u_slider",
   "u_camera_pos",
   "u_mouse",
+  "u_heatmap",
+  "u_heatmap_max",
+  "u_prepass",
+  "u_start",
+  "u_start_scale",
+  "u_tape_length",
+  "u_tile_lists",
+  "u_tiles_x",
+  "u_bvh",
+  "u_brick_coarse",
+  "u_brick_index",
+  "u_brick_atlas",
+  "u_brick_lo",
+  "u_brick_cell",
+  "u_meshes",
+  "u_rotate",
 };
   
-#if NUM_UNIFORMS != 7
+#if NUM_UNIFORMS != 27
 #error "exhaustive handling of uniforms"
 #endif
 enum Uniform {
@@ -48,8 +153,28 @@ enum Uniform {
   U_MAX_STEPS,
   U_MAX_DIST,
   U_SURF_DIST,
+  U_RELAXATION,
+  U_SHADOW_STEPS,
+  U_PENUMBRA,
+  U_FOOTPRINT,
   U_SLIDER,
   U_CAMERA_POS,
-  U_MOUSE
+  U_MOUSE,
+  U_HEATMAP,
+  U_HEATMAP_MAX,
+  U_PREPASS,
+  U_START,
+  U_START_SCALE,
+  U_TAPE_LENGTH,
+  U_TILE_LISTS,
+  U_TILES_X,
+  U_BVH,
+  U_BRICK_COARSE,
+  U_BRICK_INDEX,
+  U_BRICK_ATLAS,
+  U_BRICK_LO,
+  U_BRICK_CELL,
+  U_MESHES,
+  U_ROTATE
 };
 #endif // _SHADER_H
@@ -0,0 +1,167 @@
+#ifndef _SIMD_H_
+#define _SIMD_H_
+
+#include "main.hpp"
+
+// thin wrappers around SSE/AVX2 so the packet marcher reads like the scalar one.
+// vfloat holds SIMD_WIDTH lanes, comparisons produce a vmask with one bit per lane.
+
+#if defined(__AVX2__)
+#  include <immintrin.h>
+#  define SIMD_WIDTH 8
+#  define SIMD_NAME  "avx2"
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#  include <emmintrin.h>
+#  define SIMD_WIDTH 4
+#  define SIMD_NAME  "sse2"
+#else
+#  define SIMD_WIDTH 1
+#  define SIMD_NAME  "scalar"
+#endif
+
+#include <bitset>
+#include <math.h>
+
+#if SIMD_WIDTH == 8
+
+struct vmask {
+  __m256 v;
+  vmask (void) = default;
+  explicit vmask (__m256 m) : v(m) {}
+  explicit vmask (bool b) : v(_mm256_castsi256_ps(_mm256_set1_epi32(b ? -1 : 0))) {}
+  int bits (void) const { return _mm256_movemask_ps(v); }
+};
+
+struct vfloat {
+  __m256 v;
+  vfloat (void) = default;
+  vfloat (float f) : v(_mm256_set1_ps(f)) {}
+  explicit vfloat (__m256 f) : v(f) {}
+  static vfloat load (const float* p) { return vfloat(_mm256_loadu_ps(p)); }
+  void store (float* p) const { _mm256_storeu_ps(p, v); }
+};
+
+inline vmask operator& (vmask a, vmask b) { return vmask(_mm256_and_ps(a.v, b.v)); }
+inline vmask operator| (vmask a, vmask b) { return vmask(_mm256_or_ps(a.v, b.v)); }
+inline vmask andnot    (vmask a, vmask b) { return vmask(_mm256_andnot_ps(b.v, a.v)); } // a & ~b
+
+inline vfloat operator+ (vfloat a, vfloat b) { return vfloat(_mm256_add_ps(a.v, b.v)); }
+inline vfloat operator- (vfloat a, vfloat b) { return vfloat(_mm256_sub_ps(a.v, b.v)); }
+inline vfloat operator* (vfloat a, vfloat b) { return vfloat(_mm256_mul_ps(a.v, b.v)); }
+inline vfloat operator/ (vfloat a, vfloat b) { return vfloat(_mm256_div_ps(a.v, b.v)); }
+inline vfloat operator- (vfloat a)           { return vfloat(_mm256_xor_ps(a.v, _mm256_set1_ps(-0.0f))); }
+
+inline vmask operator< (vfloat a, vfloat b) { return vmask(_mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ)); }
+inline vmask operator> (vfloat a, vfloat b) { return vmask(_mm256_cmp_ps(a.v, b.v, _CMP_GT_OQ)); }
+
+inline vfloat vmin   (vfloat a, vfloat b) { return vfloat(_mm256_min_ps(a.v, b.v)); }
+inline vfloat vmax   (vfloat a, vfloat b) { return vfloat(_mm256_max_ps(a.v, b.v)); }
+inline vfloat vsqrt  (vfloat a)           { return vfloat(_mm256_sqrt_ps(a.v)); }
+inline vfloat vabs   (vfloat a)           { return vfloat(_mm256_andnot_ps(_mm256_set1_ps(-0.0f), a.v)); }
+inline vfloat select (vmask m, vfloat a, vfloat b) { return vfloat(_mm256_blendv_ps(b.v, a.v, m.v)); }
+
+#elif SIMD_WIDTH == 4
+
+struct vmask {
+  __m128 v;
+  vmask (void) = default;
+  explicit vmask (__m128 m) : v(m) {}
+  explicit vmask (bool b) : v(_mm_castsi128_ps(_mm_set1_epi32(b ? -1 : 0))) {}
+  int bits (void) const { return _mm_movemask_ps(v); }
+};
+
+struct vfloat {
+  __m128 v;
+  vfloat (void) = default;
+  vfloat (float f) : v(_mm_set1_ps(f)) {}
+  explicit vfloat (__m128 f) : v(f) {}
+  static vfloat load (const float* p) { return vfloat(_mm_loadu_ps(p)); }
+  void store (float* p) const { _mm_storeu_ps(p, v); }
+};
+
+inline vmask operator& (vmask a, vmask b) { return vmask(_mm_and_ps(a.v, b.v)); }
+inline vmask operator| (vmask a, vmask b) { return vmask(_mm_or_ps(a.v, b.v)); }
+inline vmask andnot    (vmask a, vmask b) { return vmask(_mm_andnot_ps(b.v, a.v)); } // a & ~b
+
+inline vfloat operator+ (vfloat a, vfloat b) { return vfloat(_mm_add_ps(a.v, b.v)); }
+inline vfloat operator- (vfloat a, vfloat b) { return vfloat(_mm_sub_ps(a.v, b.v)); }
+inline vfloat operator* (vfloat a, vfloat b) { return vfloat(_mm_mul_ps(a.v, b.v)); }
+inline vfloat operator/ (vfloat a, vfloat b) { return vfloat(_mm_div_ps(a.v, b.v)); }
+inline vfloat operator- (vfloat a)           { return vfloat(_mm_xor_ps(a.v, _mm_set1_ps(-0.0f))); }
+
+inline vmask operator< (vfloat a, vfloat b) { return vmask(_mm_cmplt_ps(a.v, b.v)); }
+inline vmask operator> (vfloat a, vfloat b) { return vmask(_mm_cmpgt_ps(a.v, b.v)); }
+
+inline vfloat vmin   (vfloat a, vfloat b) { return vfloat(_mm_min_ps(a.v, b.v)); }
+inline vfloat vmax   (vfloat a, vfloat b) { return vfloat(_mm_max_ps(a.v, b.v)); }
+inline vfloat vsqrt  (vfloat a)           { return vfloat(_mm_sqrt_ps(a.v)); }
+inline vfloat vabs   (vfloat a)           { return vfloat(_mm_andnot_ps(_mm_set1_ps(-0.0f), a.v)); }
+// SSE2 has no blendv
+inline vfloat select (vmask m, vfloat a, vfloat b) { return vfloat(_mm_or_ps(_mm_and_ps(m.v, a.v), _mm_andnot_ps(m.v, b.v))); }
+
+#else
+
+struct vmask {
+  bool v;
+  vmask (void) = default;
+  explicit vmask (bool b) : v(b) {}
+  int bits (void) const { return v ? 1 : 0; }
+};
+
+struct vfloat {
+  float v;
+  vfloat (void) = default;
+  vfloat (float f) : v(f) {}
+  static vfloat load (const float* p) { return vfloat(*p); }
+  void store (float* p) const { *p = v; }
+};
+
+inline vmask operator& (vmask a, vmask b) { return vmask(a.v && b.v); }
+inline vmask operator| (vmask a, vmask b) { return vmask(a.v || b.v); }
+inline vmask andnot    (vmask a, vmask b) { return vmask(a.v && !b.v); }
+
+inline vfloat operator+ (vfloat a, vfloat b) { return vfloat(a.v + b.v); }
+inline vfloat operator- (vfloat a, vfloat b) { return vfloat(a.v - b.v); }
+inline vfloat operator* (vfloat a, vfloat b) { return vfloat(a.v * b.v); }
+inline vfloat operator/ (vfloat a, vfloat b) { return vfloat(a.v / b.v); }
+inline vfloat operator- (vfloat a)           { return vfloat(-a.v); }
+
+inline vmask operator< (vfloat a, vfloat b) { return vmask(a.v < b.v); }
+inline vmask operator> (vfloat a, vfloat b) { return vmask(a.v > b.v); }
+
+inline vfloat vmin   (vfloat a, vfloat b) { return vfloat(a.v < b.v ? a.v : b.v); }
+inline vfloat vmax   (vfloat a, vfloat b) { return vfloat(a.v > b.v ? a.v : b.v); }
+inline vfloat vsqrt  (vfloat a)           { return vfloat(sqrtf(a.v)); }
+inline vfloat vabs   (vfloat a)           { return vfloat(fabsf(a.v)); }
+inline vfloat select (vmask m, vfloat a, vfloat b) { return m.v ? a : b; }
+
+#endif
+
+inline bool any   (vmask m) { return m.bits() != 0; }
+inline int  count (vmask m) { return static_cast<int>(std::bitset<SIMD_WIDTH>(static_cast<unsigned long long>(m.bits())).count()); } // lanes set
+
+inline vfloat& operator+= (vfloat& a, vfloat b) { return a = a + b; }
+inline vfloat& operator-= (vfloat& a, vfloat b) { return a = a - b; }
+inline vfloat& operator*= (vfloat& a, vfloat b) { return a = a * b; }
+
+inline vfloat vclamp (vfloat x, vfloat lo, vfloat hi) { return vmin(vmax(x, lo), hi); }
+inline vfloat vmix   (vfloat a, vfloat b, vfloat t)   { return a + (b - a) * t; }
+
+// three component vector of lanes, one ray or point per lane
+struct vvec3 {
+  vfloat x, y, z;
+  vvec3 (void) = default;
+  vvec3 (vfloat a, vfloat b, vfloat c) : x(a), y(b), z(c) {}
+  vvec3 (const vec3& v) : x(v.x), y(v.y), z(v.z) {}
+};
+
+inline vvec3 operator+ (const vvec3& a, const vvec3& b) { return vvec3(a.x + b.x, a.y + b.y, a.z + b.z); }
+inline vvec3 operator- (const vvec3& a, const vvec3& b) { return vvec3(a.x - b.x, a.y - b.y, a.z - b.z); }
+inline vvec3 operator* (const vvec3& a, vfloat s)       { return vvec3(a.x * s, a.y * s, a.z * s); }
+inline vvec3 operator- (const vvec3& a)                 { return vvec3(-a.x, -a.y, -a.z); }
+
+inline vfloat vdot       (const vvec3& a, const vvec3& b) { return a.x*b.x + a.y*b.y + a.z*b.z; }
+inline vfloat vlength    (const vvec3& a)                 { return vsqrt(vdot(a, a)); }
+inline vvec3  vnormalize (const vvec3& a)                 { return a * (vfloat(1.0f) / vlength(a)); }
+
+#endif // _SIMD_H_
@@ -0,0 +1,243 @@
+#include "tile_cull.hpp"
+
+static void find_objects(const scene_t& scene, int index, std::vector<cull_object_t>& objects) {
+  const scene_node_t& n { scene.nodes[index] };
+  if (n.kind == SCENE_OR) {
+    find_objects(scene, n.children[0], objects);
+    find_objects(scene, n.children[1], objects);
+    return;
+  }
+  cull_object_t object {};
+  object.node = index;
+  objects.push_back(object);
+}
+
+void scene_objects(const scene_t& scene, std::vector<cull_object_t>& objects) {
+  objects.clear();
+  if (scene.root >= 0) find_objects(scene, scene.root, objects);
+}
+
+void tile_cull_t::init(const scene_t& scene) {
+  scene_objects(scene, objects);
+}
+
+cull_bounds_t merge_bounds(const cull_bounds_t& a, const cull_bounds_t& b) {
+  cull_bounds_t m {};
+  m.beta = glm::max(a.beta, b.beta);
+  if (std::isinf(a.alpha) || std::isinf(b.alpha)) return m;
+
+  // the smallest sphere around both
+  const float dist { length(b.centre - a.centre) };
+  if (dist + b.alpha <= a.alpha) m.centre = a.centre, m.alpha = a.alpha;
+  else if (dist + a.alpha <= b.alpha) m.centre = b.centre, m.alpha = b.alpha;
+  else {
+    m.alpha  = 0.5f * (dist + a.alpha + b.alpha);
+    m.centre = a.centre + (b.centre - a.centre) * ((m.alpha - a.alpha) / dist);
+  }
+  m.alpha *= 1.0001f; // rounding in the centre
+  return m;
+}
+
+cull_bounds_t cull_bounds(const scene_t& scene, int index) {
+  const scene_node_t& n { scene.nodes[index] };
+  const float*        v { &scene.bound[index * SCENE_MAX_PARAMS] };
+  cull_bounds_t       b {};
+
+  switch (n.kind) {
+  case SCENE_PLANE:
+    return b;
+  case SCENE_SPHERE:
+    b.alpha = abs(v[0]);
+    return b;
+  case SCENE_CAPSULE:
+  case SCENE_CYLINDER: {
+    const vec3 p0 { v[0], v[1], v[2] };
+    const vec3 p1 { v[3], v[4], v[5] };
+    b.centre = 0.5f * (p0 + p1);
+    b.alpha  = 0.5f * length(p1 - p0) + abs(v[6]);
+    return b;
+  }
+  case SCENE_TORUS:
+    b.alpha = abs(v[0]) + abs(v[1]);
+    return b;
+  case SCENE_BOX:
+    b.alpha = length(vec3(v[0], v[1], v[2]));
+    return b;
+  case SCENE_MESH: { // the cube of samples, outside it the distance is at least the cube's
+    const float half { 0.5f * v[3] * (v[5] - 1.0f) };
+    b.centre = vec3(v[0], v[1], v[2]) + half;
+    b.alpha  = 1.7320508f * half;
+    return b;
+  }
+
+  case SCENE_OR:
+  case SCENE_LOD: // either child's
+    return merge_bounds(cull_bounds(scene, n.children[0]), cull_bounds(scene, n.children[1]));
+  case SCENE_AND: { // inside both, the tighter one will do
+    const cull_bounds_t a { cull_bounds(scene, n.children[0]) };
+    const cull_bounds_t c { cull_bounds(scene, n.children[1]) };
+    return a.alpha <= c.alpha ? a : c;
+  }
+  case SCENE_MINUS: // inside what's cut from
+    return cull_bounds(scene, n.children[0]);
+  case SCENE_OR_SMOOTH: // at most k / 4 below the plain union
+    b = merge_bounds(cull_bounds(scene, n.children[0]), cull_bounds(scene, n.children[1]));
+    b.alpha += b.beta * 0.25f * abs(v[0]);
+    return b;
+
+  // the child sees q, map its bounds back to p
+  case SCENE_TRANSLATE:
+    b = cull_bounds(scene, n.children[0]);
+    b.centre += vec3(v[0], v[1], v[2]);
+    return b;
+  case SCENE_SCALE: { // q = p * s, so the child's distances are s times the ones in p
+    b = cull_bounds(scene, n.children[0]);
+    const float s { abs(v[0]) };
+    if (s == 0.0f) return cull_bounds_t {};
+    b.centre /= v[0];
+    b.alpha  /= s;
+    b.beta   /= s;
+    return b;
+  }
+  case SCENE_ROTATE: { // q.xy = Rotate(a) p.xy, v[1] and v[2] are its sin and cos
+    b = cull_bounds(scene, n.children[0]);
+    const vec3 c { b.centre };
+    b.centre = vec3(c.x*v[2] + c.y*v[1], -c.x*v[1] + c.y*v[2], c.z);
+    return b;
+  }
+  case SCENE_TRANSFORM: { // q = Rotate(a) (p - offset) * s, the three above in reverse
+    b = cull_bounds(scene, n.children[0]);
+    const float s { abs(v[3]) };
+    if (s == 0.0f) return cull_bounds_t {};
+    const vec3 c { b.centre / v[3] };
+    b.centre = vec3(c.x*v[6] + c.y*v[5], -c.x*v[5] + c.y*v[6], c.z) + vec3(v[0], v[1], v[2]);
+    b.alpha /= s;
+    b.beta  /= s;
+    return b;
+  }
+  default:
+    return b;
+  }
+}
+
+// range of pixels along one screen axis the sphere can cover, from the angles of its tangents
+// in the plane of that axis and the view direction. false when it's behind the camera
+static bool project_axis(float x, float z, float radius, float scale, float centre_px, float& lo, float& hi) {
+  constexpr float half_pi { 1.57079632679f };
+  const float dist2 { x*x + z*z };
+  lo = -INFINITY;
+  hi =  INFINITY;
+  if (dist2 <= radius*radius) return true;
+
+  const float angle { atan2(x, z) };
+  const float half  { asin(radius / sqrt(dist2)) };
+  if (angle - half >= half_pi || angle + half <= -half_pi) return false;
+  if (angle - half > -half_pi) lo = tan(angle - half) * scale + centre_px;
+  if (angle + half <  half_pi) hi = tan(angle + half) * scale + centre_px;
+  return true;
+}
+
+void tile_cull_t::build(const scene_t& scene, int width, int height, const camera_t& camera,
+                        const ray_march_params_t& params) {
+  tiles_x = (width  + CULL_TILE_SIZE - 1) / CULL_TILE_SIZE;
+  tiles_y = (height + CULL_TILE_SIZE - 1) / CULL_TILE_SIZE;
+  const int num_tiles { tiles_x * tiles_y };
+
+  // the camera of fragment.glsl, uv = (frag_coord - 0.5 * resolution) / resolution.y and
+  // rd = f + uv.x * r + uv.y * u, where r and u are both cos(pitch) long
+  const vec3  look_at { cos(camera.pitch) * sin(camera.yaw), sin(camera.pitch), cos(camera.pitch) * cos(camera.yaw) };
+  const vec3  f       { normalize(look_at) };
+  const vec3  r       { cross(vec3(0.0f, 1.0f, 0.0f), f) };
+  const vec3  u       { cross(f, r) };
+  const float len     { length(r) };
+  const float scale   { static_cast<float>(height) / len }; // pixels per unit of x / z
+  const float pixel   { params.footprint / static_cast<float>(height) }; // hit threshold per unit of t
+
+  // tile rectangles first, then counts, offsets and the lists
+  std::vector<ivec4> rects(objects.size());
+  std::vector<uint32_t> counts(num_tiles, 0);
+  for (size_t i = 0; i < objects.size(); ++i) {
+    cull_object_t&      object { objects[i] };
+    const cull_bounds_t b      { cull_bounds(scene, object.node) };
+    object.centre = b.centre;
+    object.radius = b.alpha;
+
+    // rays hit once the distance is below surf_dist, or t * pixel with a footprint, where the
+    // bounds reach beta times that past alpha. t is at most dist + radius within the sphere,
+    // so radius = alpha + beta * (dist + radius) * pixel
+    const vec3  rel    { b.centre - vec3(camera.position) };
+    const float dist   { length(rel) };
+    const float grow   { 1.0f - b.beta * pixel };
+    const float radius { grow > 0.0f ? glm::max(b.alpha + b.beta * params.surf_dist, (b.alpha + b.beta * dist * pixel) / grow)
+                                     : INFINITY };
+
+    ivec4& rect { rects[i] };
+    rect = ivec4(0, 0, tiles_x - 1, tiles_y - 1);
+    if (!std::isinf(radius)) {
+      const float z  { dot(rel, f) };
+      float x0, x1, y0, y1;
+      if (!project_axis(dot(rel, r) / len, z, radius, scale, 0.5f * width,  x0, x1) ||
+          !project_axis(dot(rel, u) / len, z, radius, scale, 0.5f * height, y0, y1) ||
+          x1 < 0.0f || y1 < 0.0f || x0 > width || y0 > height) {
+        rect = ivec4(0, 0, -1, -1);
+        continue;
+      }
+      rect = ivec4(glm::max(0, static_cast<int>(floor(glm::max(x0, 0.0f) / CULL_TILE_SIZE))),
+                   glm::max(0, static_cast<int>(floor(glm::max(y0, 0.0f) / CULL_TILE_SIZE))),
+                   glm::min(tiles_x - 1, static_cast<int>(floor(glm::min(x1, static_cast<float>(width))  / CULL_TILE_SIZE))),
+                   glm::min(tiles_y - 1, static_cast<int>(floor(glm::min(y1, static_cast<float>(height)) / CULL_TILE_SIZE))));
+    }
+    for (int ty = rect.y; ty <= rect.w; ++ty)
+      for (int tx = rect.x; tx <= rect.z; ++tx) ++counts[ty * tiles_x + tx];
+  }
+
+  lists.assign(2 * num_tiles, 0);
+  uint32_t offset { static_cast<uint32_t>(2 * num_tiles) };
+  for (int t = 0; t < num_tiles; ++t) {
+    lists[2 * t]     = offset;
+    lists[2 * t + 1] = 0;
+    offset          += counts[t];
+  }
+  lists.resize(offset);
+  entries = offset - 2 * num_tiles;
+
+  for (size_t i = 0; i < objects.size(); ++i)
+    for (int ty = rects[i].y; ty <= rects[i].w; ++ty)
+      for (int tx = rects[i].x; tx <= rects[i].z; ++tx) {
+        const int t { ty * tiles_x + tx };
+        lists[lists[2 * t] + lists[2 * t + 1]++] = static_cast<uint32_t>(i);
+      }
+}
+
+// a binary search over the indices rather than a switch, all of a tile takes the same branches
+static void emit_dispatch(int first, int last, const std::string& suffix, const std::string& indent, std::string& src) {
+  if (first == last) {
+    src += indent + "return sdf_object_" + std::to_string(first) + suffix + "(p);\n";
+    return;
+  }
+  const int mid { (first + last) / 2 };
+  src += indent + "if (i <= " + std::to_string(mid) + ") {\n";
+  emit_dispatch(first, mid, suffix, indent + "  ", src);
+  src += indent + "} else {\n";
+  emit_dispatch(mid + 1, last, suffix, indent + "  ", src);
+  src += indent + "}\n";
+}
+
+std::string objects_glsl(const scene_t& scene, const std::vector<cull_object_t>& objects, bool dual) {
+  std::string src {};
+  for (int pass = 0; pass < (dual ? 2 : 1); ++pass) {
+    const std::string suffix { pass ? "_dual" : "" };
+    for (size_t i = 0; i < objects.size(); ++i)
+      src += scene.glsl(objects[i].node, "sdf_object_" + std::to_string(i) + suffix, pass == 1);
+
+    src += (pass ? "vec4" : "float") + std::string(" sdf_object") + suffix + "(int i, vec3 p) {\n";
+    if (objects.empty()) src += pass ? "  return vec4(1e10, 0., 0., 0.);\n" : "  return 1e10;\n";
+    else emit_dispatch(0, static_cast<int>(objects.size()) - 1, suffix, "  ", src);
+    src += "}\n";
+  }
+  return src;
+}
+
+std::string tile_cull_t::glsl() const {
+  return "#define SDF_CULL\n#define CULL_TILE " + std::to_string(CULL_TILE_SIZE) + "\n";
+}
@@ -0,0 +1,52 @@
+#ifndef _TILE_CULL_H_
+#define _TILE_CULL_H_
+
+#include "main.hpp"
+#include "scene.hpp"
+
+#include <string>
+#include <vector>
+
+// screen tiles the GLSL path bins scene objects into, in pixels
+#define CULL_TILE_SIZE 16
+
+// the objects are the subtrees the scene's top level `or`s join. a ray can only hit the objects
+// whose bounds reach its tile, so primary rays march on the min of those and skip the rest.
+// smooth unions are one object, their bounds grow by what the blend adds
+struct cull_object_t {
+  int   node   { -1 };
+  vec3  centre { 0.0f };
+  float radius { 0.0f }; // INFINITY for planes and whatever contains one
+};
+
+// where a node's distance is below v: within alpha + beta * v of centre. beta is one over the
+// smallest scale the distance has below the node, smooth unions add beta * k / 4 to alpha
+struct cull_bounds_t {
+  vec3  centre { 0.0f };
+  float alpha  { INFINITY };
+  float beta   { 1.0f };
+};
+
+// the subtrees the scene's top level `or`s join
+void          scene_objects (const scene_t&, std::vector<cull_object_t>&);
+// bounds of a node with the scene's params as bind() left them
+cull_bounds_t cull_bounds   (const scene_t&, int);
+cull_bounds_t merge_bounds  (const cull_bounds_t&, const cull_bounds_t&); // a sphere holding both
+// float sdf_object_N(vec3 p) per object and float sdf_object(int i, vec3 p) picking one,
+// with dual also their vec4 sdf_object_N_dual and sdf_object_dual of the distance and gradient
+std::string   objects_glsl  (const scene_t&, const std::vector<cull_object_t>&, bool = false);
+
+struct tile_cull_t {
+  std::vector<cull_object_t> objects;
+  int                        tiles_x { 0 };
+  int                        tiles_y { 0 };
+  // per tile the offset of its list in here and its length, then the lists of object indices
+  std::vector<uint32_t>      lists;
+  size_t                     entries { 0 }; // object indices over all tiles
+
+  void        init  (const scene_t&); // finds the objects, again whenever the scene changes
+  void        build (const scene_t&, int, int, const camera_t&, const ray_march_params_t&); // bound scene, frame size
+  std::string glsl  (void) const; // defines for fragment.glsl, after objects_glsl
+};
+
+#endif // _TILE_CULL_H_
@@ -36,8 +36,9 @@ char* slurp_file(const char* file_path, size_t* size) {
   if (f == NULL) SLURP_FILE_PANIC;
   if (fseek(f, 0, SEEK_END) < 0) SLURP_FILE_PANIC;
   
-  *size = ftell(f);
-  if (size < 0) SLURP_FILE_PANIC;
+  const long end { ftell(f) };
+  if (end < 0) SLURP_FILE_PANIC;
+  *size = static_cast<size_t>(end);
   
   char *buffer { static_cast<char*>(calloc(*size + 1, sizeof(char))) }; // NOTE: calloc because there was an issue with garbage at the end sometimes so we null terminate
   if (buffer == NULL) SLURP_FILE_PANIC;
@@ -53,3 +54,80 @@ char* slurp_file(const char* file_path, size_t* size) {
 #undef SLURP_FILE_PANIC
 }
 
+
+// writes a bottom-up RGBA8 image (as read back from GL) as a binary PPM
+bool write_ppm(const char* file_path, int width, int height, const uint8_t* rgba) {
+  FILE *f { fopen(file_path, "wb") };
+  if (f == NULL) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Could not open `%s` for writing", file_path);
+    return false;
+  }
+
+  fprintf(f, "P6\n%d %d\n255\n", width, height);
+  uint8_t* row { static_cast<uint8_t*>(malloc(static_cast<size_t>(width) * 3)) };
+  for (int y = height - 1; y >= 0; --y) {
+    const uint8_t* src { rgba + static_cast<size_t>(y) * width * 4 };
+    for (int x = 0; x < width; ++x) {
+      row[x*3 + 0] = src[x*4 + 0];
+      row[x*3 + 1] = src[x*4 + 1];
+      row[x*3 + 2] = src[x*4 + 2];
+    }
+    fwrite(row, 3, width, f);
+  }
+  free(row);
+
+  const bool ok { ferror(f) == 0 };
+  fclose(f);
+  return ok;
+}
+
+// the length of the conversion at pattern, which starts with a %, or 0 if it isn't one we take
+static size_t frame_conversion(const char* pattern, int* width) {
+  size_t n { 1 };
+  *width = 0;
+  if (pattern[n] == '%') return 2;
+  if (pattern[n] == '0') ++n;
+  while (pattern[n] >= '0' && pattern[n] <= '9' && *width < 100) *width = *width * 10 + (pattern[n++] - '0');
+  return pattern[n] == 'd' && (n == 1 || pattern[1] == '0') ? n + 1 : 0;
+}
+
+int frame_path_numbers(const char* pattern) {
+  int numbers { 0 };
+  for (const char* c = pattern; *c; ++c) {
+    if (*c != '%') continue;
+    int          width;
+    const size_t n { frame_conversion(c, &width) };
+    if (n == 0) return -1;
+    if (c[n - 1] == 'd') ++numbers;
+    c += n - 1;
+  }
+  return numbers;
+}
+
+void frame_path(char* out, size_t size, const char* pattern, int frame) {
+  size_t o { 0 };
+  for (const char* c = pattern; *c && o + 1 < size; ++c) {
+    int          width;
+    const size_t n { *c == '%' ? frame_conversion(c, &width) : 0 };
+    if (n == 0) {
+      out[o++] = *c;
+    } else if (c[n - 1] == '%') {
+      out[o++] = '%';
+    } else {
+      const int written { snprintf(out + o, size - o, "%0*d", width, frame) };
+      if (written > 0) o += static_cast<size_t>(written);
+      if (o > size - 1) o = size - 1;
+    }
+    if (n) c += n - 1;
+  }
+  out[o] = '\0';
+}
+
+uint64_t hash_bytes(const void* data, size_t size, uint64_t h) {
+  const uint8_t* bytes { static_cast<const uint8_t*>(data) };
+  for (size_t i = 0; i < size; ++i) {
+    h ^= bytes[i];
+    h *= 0x100000001b3ull;
+  }
+  return h;
+}
@@ -9,7 +9,25 @@
 #include <unistd.h>
 #endif
 #ifdef WIN32
+#include <direct.h>
 #define stat _stat
+#define make_dir(path) _mkdir(path)
+#define strcasecmp _stricmp
+#else
+#define make_dir(path) mkdir((path), 0755)
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+// the msvc secure crt functions used by slurp_file
+static inline int fopen_s(FILE** f, const char* path, const char* mode) {
+  *f = fopen(path, mode);
+  return *f ? 0 : errno;
+}
+static inline int strerror_s(char* buf, size_t len, int err) {
+  snprintf(buf, len, "%s", strerror(err));
+  return 0;
+}
 #endif
 
 constexpr inline void _checkp(const char*, const int, const void*);
@@ -20,5 +38,16 @@ constexpr inline void _check (const char*, const int, const int);
 
 uint64_t get_last_modified_time(const char*);
 char* slurp_file(const char*, size_t*);
+bool write_ppm(const char*, int, int, const uint8_t*);
+
+// --out patterns: %d for the frame number, zero padded with a width like %04d, and %% for a
+// literal %. frame_path_numbers is how many frame numbers the pattern takes, -1 if it has any
+// other conversion. frame_path substitutes them itself, the pattern is never a printf format
+int frame_path_numbers(const char*);
+void frame_path(char*, size_t, const char*, int);
+
+// 64 bit FNV-1a, pass the previous result to hash several buffers as one
+#define HASH_SEED 0xcbf29ce484222325ull
+uint64_t hash_bytes(const void*, size_t, uint64_t = HASH_SEED);
 
 #endif // _UTIL_H_